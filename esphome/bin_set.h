@@ -0,0 +1,164 @@
+#pragma once
+
+#include "pump_drive.h"
+#include "pump_state.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Per-bin entity table
+//
+// Each config describes its bins once, in its own *_bins.h, as a constexpr
+// table of accessors for the ESPHome ids behind each bin. The helpers then
+// index that table by bin number instead of switching over id(bin_1_...)
+// ... id(bin_4_...), so the same flood_helpers.h serves a single-bin shelf,
+// the 4-bin shelf and an 8-bin multiplexed build. Only the bins listed in
+// the table are compiled in.
+//
+// Entries are captureless lambdas so the table can be constexpr regardless of
+// the exact component class behind an id. An entity a config doesn't have is
+// left out of its table (nullptr) and reads back as the helper's default.
+
+struct BinRefs {
+  bool (*enable)() = nullptr;
+  float (*target_depth)() = nullptr;
+  float (*empty_distance)() = nullptr;
+  float (*distance)() = nullptr;
+  void (*set_sample_interval)(uint32_t ms) = nullptr;
+  float (*cycle_interval)() = nullptr;
+  float (*fill_duration)() = nullptr;
+  float (*soak_duration)() = nullptr;
+  float (*drain_duration)() = nullptr;
+  float (*fill_speed)() = nullptr;   // percent
+  float (*drain_speed)() = nullptr;  // percent
+  const std::string &(*daily_times)() = nullptr;
+  int &(*schedule_mode)() = nullptr;
+  int &(*interval_time)() = nullptr;
+  int &(*next_cycle)() = nullptr;
+  int &(*last_cycle)() = nullptr;
+  int &(*last_run_day)() = nullptr;
+  bool &(*queue_pending)() = nullptr;
+  void (*publish_status)(const char *text) = nullptr;
+  void (*publish_stop_latency)(float ms) = nullptr;
+  void (*publish_fill_error)(float mm) = nullptr;
+  void (*update_countdown)() = nullptr;
+  bool (*pump_on)() = nullptr;
+  bool (*reverse)() = nullptr;
+  void (*set_direction)(bool forward, bool reverse) = nullptr;
+  void (*set_speed_level)(float level) = nullptr;
+  PumpDrive drive = {};
+  void (*set_pump)(bool on) = nullptr;     // the pump and reverse switches, so the
+  void (*set_reverse)(bool on) = nullptr;  // flood cycle drives them as HA would
+  CycleEnd fill_end = CycleEnd::TIMED;
+  CycleEnd drain_end = CycleEnd::TIMED;
+  float (*drain_plateau_rate)() = nullptr;    // mm/min a depth-ended drain counts as done below
+  float (*drain_plateau_window)() = nullptr;  // seconds that rate is measured over
+  bool (*auto_calibrate)() = nullptr;         // empty distance calibration switch (empty_calibrator.h)
+  void (*set_empty_distance)(float mm) = nullptr;
+  void (*publish_calibration_confidence)(float percent) = nullptr;
+};
+
+// Shelf-wide entities, one per config; a config without them leaves them
+// nullptr and the helpers fall back to defaults
+struct ShelfRefs {
+  float (*watering_hour)() = nullptr;
+  float (*supply_budget)() = nullptr;
+  float (*pump_rated_current)() = nullptr;
+  void (*flush_outputs)() = nullptr;  // pumps on I2C driver boards (pump_outputs.h)
+  void (*publish_state)(const char *text) = nullptr;  // aggregated shelf state (shelf_state.h)
+  bool (*low_power)() = nullptr;                       // low-power idle switch
+  void (*set_tick_interval)(uint32_t ms) = nullptr;    // the interval calling service_timers()
+
+  // Read a setting, or fallback if the config doesn't have it
+  constexpr float get(float (*ShelfRefs::*field)(), float fallback) const {
+    return this->*field == nullptr ? fallback : (this->*field)();
+  }
+
+  // Send batched pump output changes, if the shelf batches them
+  void flush() const {
+    if (this->flush_outputs != nullptr) this->flush_outputs();
+  }
+
+  // Publish the aggregated shelf state, if the config has the entity
+  void publish(const char *text) const {
+    if (this->publish_state != nullptr) this->publish_state(text);
+  }
+
+  // Low-power idle is on, and the config can stretch the timer tick for it
+  bool low_power_idle() const {
+    return this->low_power != nullptr && this->set_tick_interval != nullptr && this->low_power();
+  }
+
+  void set_tick(uint32_t ms) const {
+    if (this->set_tick_interval != nullptr) this->set_tick_interval(ms);
+  }
+};
+
+// Accessor builders for BinRefs entries
+#define FLOOD_STATE(entity) []() { return id(entity).state; }
+#define FLOOD_TEXT(entity) []() -> const std::string & { return id(entity).state; }
+#define FLOOD_GLOBAL(var) []() -> auto & { return id(var).value(); }
+#define FLOOD_PUBLISH(entity) [](const char *text) { id(entity).publish_state(text); }
+// For texts too long for std::string's inline storage: the copy and the
+// entity's state keep a buffer of the given size, so publishing doesn't
+// allocate after the first call
+#define FLOOD_PUBLISH_RESERVED(entity, size) \
+  [](const char *text) { \
+    static std::string buffer; \
+    if (buffer.capacity() < (size)) { \
+      buffer.reserve(size); \
+      id(entity).state.reserve(size); \
+    } \
+    buffer.assign(text); \
+    id(entity).publish_state(buffer); \
+  }
+#define FLOOD_PUBLISH_VALUE(entity) [](float value) { id(entity).publish_state(value); }
+#define FLOOD_SWITCH(entity) [](bool on) { on ? id(entity).turn_on() : id(entity).turn_off(); }
+#define FLOOD_UPDATE(entity) []() { id(entity).update(); }
+#define FLOOD_SET_LEVEL(output) [](float level) { id(output).set_level(level); }
+#define FLOOD_HBRIDGE(forward_pin, reverse_pin) \
+  [](bool forward, bool reverse) { \
+    forward ? id(forward_pin).turn_on() : id(forward_pin).turn_off(); \
+    reverse ? id(reverse_pin).turn_on() : id(reverse_pin).turn_off(); \
+  }
+#define FLOOD_POLL_INTERVAL(entity) \
+  [](uint32_t ms) { \
+    id(entity).set_update_interval(ms); \
+    id(entity).start_poller(); \
+  }
+
+// Keeps a fallback argument out of template argument deduction
+template<typename T> struct bin_field_type {
+  using type = T;
+};
+
+template<size_t N> struct BinSet {
+  static_assert(N >= 1, "a shelf needs at least one bin");
+
+  BinRefs table[N];
+
+  static constexpr int size() { return N; }
+
+  // True for bin numbers 1..N
+  static constexpr bool contains(int bin_num) { return bin_num >= 1 && bin_num <= (int)N; }
+
+  // Bin numbers are 1-based to match the entity names
+  constexpr const BinRefs &operator[](int bin_num) const { return this->table[bin_num - 1]; }
+
+  // Read a field of a bin, or fallback if the bin or entity doesn't exist
+  template<typename T> T get(int bin_num, T (*BinRefs::*field)(), typename bin_field_type<T>::type fallback) const {
+    if (!contains(bin_num) || (*this)[bin_num].*field == nullptr) return fallback;
+    return ((*this)[bin_num].*field)();
+  }
+  template<typename T> T get(int bin_num, T &(*BinRefs::*field)(), typename bin_field_type<T>::type fallback) const {
+    if (!contains(bin_num) || (*this)[bin_num].*field == nullptr) return fallback;
+    return ((*this)[bin_num].*field)();
+  }
+
+  // Write a global of a bin; ignored if the bin or global doesn't exist
+  template<typename T> void set(int bin_num, T &(*BinRefs::*field)(), typename bin_field_type<T>::type value) const {
+    if (!contains(bin_num) || (*this)[bin_num].*field == nullptr) return;
+    ((*this)[bin_num].*field)() = value;
+  }
+};
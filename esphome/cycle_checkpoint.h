@@ -0,0 +1,105 @@
+#pragma once
+
+#include "esphome.h"
+#include "flood_journal.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef USE_ESP32
+#include "esp_attr.h"
+#endif
+#ifndef RTC_NOINIT_ATTR
+#define RTC_NOINIT_ATTR
+#endif
+
+// Flood cycle checkpoints in RTC memory
+//
+// A reset mid-cycle (a brownout as a pump starts, an OTA, the watchdog)
+// loses the cycle's place with the rest of RAM, and can leave a tray full
+// until the next cycle. The checkpoint keeps each bin's step and its deadline
+// in RTC slow memory, which survives every reset but a power cut and costs
+// nothing to write: one entry per step change, plus the timer wheel's tick
+// each second so the deadline can be turned back into time left. Each entry
+// carries its own CRC, so a reset in the middle of a write loses at most
+// that entry, and memory that power-on left random fails the check.
+//
+// Declare the object RTC_NOINIT_ATTR: it has no constructor, so nothing
+// clears it at boot.
+
+template<size_t N> class CycleCheckpoint {
+ public:
+  static const uint8_t IDLE = 0xFF;  // FloodCycle::IDLE
+
+  // What a reset interrupted in one bin
+  struct Saved {
+    uint8_t step;         // cycle step, or IDLE
+    uint8_t resumes;      // times this step was already resumed after a reset
+    uint32_t remaining_s;
+  };
+
+  // Read back what the last boot left; false (and every bin IDLE) if there is
+  // no valid checkpoint. Call once at boot, then reset().
+  bool restore(Saved (&out)[N]) const {
+    for (size_t i = 0; i < N; i++) out[i] = {IDLE, 0, 0};
+    if (this->key_ != KEY) return false;
+    // The tick and its complement are written one after the other; if a reset
+    // fell between them, they are a tick apart and the earlier one counts
+    uint32_t tick = this->tick_;
+    uint32_t other = ~this->tick_inverse_;
+    if (tick - other > 1 && other - tick > 1) return false;
+    if ((int32_t)(other - tick) < 0) tick = other;
+    for (size_t i = 0; i < N; i++) {
+      const Entry &entry = this->entries_[i];
+      if (entry.crc != crc_of(entry) || entry.step == IDLE) continue;
+      int32_t remaining = (int32_t)(entry.deadline - tick);
+      out[i] = {entry.step, entry.resumes, remaining > 0 ? (uint32_t) remaining : 0};
+    }
+    return true;
+  }
+
+  // Start over with every bin idle, at tick 0 of a new timer wheel
+  void reset() {
+    this->key_ = KEY;
+    this->set_tick(0);
+    for (size_t i = 0; i < N; i++) this->save(i + 1, IDLE, 0, 0);
+  }
+
+  // Bin bin_num entered step, due to end at wheel tick deadline
+  void save(int bin_num, uint8_t step, uint32_t deadline, uint8_t resumes) {
+    if (bin_num < 1 || bin_num > (int) N) return;
+    Entry &entry = this->entries_[bin_num - 1];
+    entry.deadline = deadline;
+    entry.step = step;
+    entry.resumes = resumes;
+    entry.reserved = 0;
+    entry.crc = crc_of(entry);
+  }
+
+  // Current wheel tick; call every tick
+  void set_tick(uint32_t tick) {
+    this->tick_ = tick;
+    this->tick_inverse_ = ~tick;
+  }
+
+ protected:
+  // Bin count in the key, so a different table never resumes this one
+  static const uint32_t KEY = 0x464C4300 + N;
+
+  struct Entry {
+    uint32_t deadline;
+    uint8_t step;
+    uint8_t resumes;
+    uint16_t reserved;
+    uint32_t crc;
+  };
+
+  static uint32_t crc_of(const Entry &entry) {
+    return journal_crc32(reinterpret_cast<const uint8_t *>(&entry), offsetof(Entry, crc));
+  }
+
+  uint32_t key_;
+  uint32_t tick_;
+  uint32_t tick_inverse_;
+  Entry entries_[N];
+};
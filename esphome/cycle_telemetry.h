@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Per-cycle telemetry
+//
+// Each flood cycle is summarised into one fixed-size CycleRecord: phase
+// durations, fill and drain timeouts, target, peak and settled depth, and a
+// depth curve over the whole cycle. The curve starts at one point a second
+// and, whenever it fills up, drops every other point and doubles its step, so
+// any cycle length fits in the same CURVE_POINTS bytes. The last N records of
+// a bin are kept in a CycleLog ring; nothing here allocates.
+
+enum CycleFlag : uint8_t {
+  CYCLE_FILL_TIMEOUT = 1,   // fill stopped by max fill time, not by depth
+  CYCLE_DRAIN_TIMEOUT = 2,  // drain ended with water still in the tray
+  CYCLE_NO_DEPTH = 4,       // no depth samples (time-based shelf)
+};
+
+struct CycleRecord {
+  static const size_t CURVE_POINTS = 64;
+
+  uint32_t start_time = 0;       // epoch seconds (0 if the clock wasn't set)
+  uint16_t fill_s = 0;
+  uint16_t soak_s = 0;
+  uint16_t drain_s = 0;
+  uint16_t drain_plateau_s = 0;  // drain start to the last sample still falling
+  uint16_t curve_step_s = 1;     // seconds between curve points
+  int16_t target_dmm = 0;        // depths in 0.1 mm
+  int16_t peak_dmm = 0;
+  int16_t error_dmm = 0;         // settled depth minus target
+  uint8_t flags = 0;
+  uint8_t curve_count = 0;
+  uint8_t curve[CURVE_POINTS];   // depth in mm, clamped to 0..255
+};
+
+// Builds the record of the cycle in progress
+class CycleRecorder {
+ public:
+  void begin(uint32_t ms, uint32_t start_time, float target) {
+    this->record_ = CycleRecord();
+    this->record_.start_time = start_time;
+    this->record_.target_dmm = to_dmm(target);
+    this->record_.flags = CYCLE_NO_DEPTH;
+    this->start_ms_ = ms;
+    this->drain_start_ms_ = 0;
+    this->last_depth_ = NAN;
+    this->active_ = true;
+  }
+
+  bool active() const { return this->active_; }
+
+  // Depth sample at any point in the cycle
+  void sample(uint32_t ms, float depth) {
+    if (!this->active_) return;
+    CycleRecord &record = this->record_;
+    record.flags &= ~CYCLE_NO_DEPTH;
+    this->last_depth_ = depth;
+    int16_t dmm = to_dmm(depth);
+    if (dmm > record.peak_dmm) record.peak_dmm = dmm;
+
+    // Drain plateau: last time the level was still dropping by a millimetre
+    if (this->drain_start_ms_ != 0) {
+      if (depth < this->drain_low_ - 1.0f) {
+        this->drain_low_ = depth;
+        record.drain_plateau_s = (ms - this->drain_start_ms_) / 1000;
+      }
+    }
+
+    uint32_t elapsed_s = (ms - this->start_ms_) / 1000;
+    if (elapsed_s < (uint32_t) record.curve_count * record.curve_step_s) return;
+    if (record.curve_count == CycleRecord::CURVE_POINTS) {
+      for (size_t i = 0; i < CycleRecord::CURVE_POINTS / 2; i++) record.curve[i] = record.curve[i * 2];
+      record.curve_count = CycleRecord::CURVE_POINTS / 2;
+      record.curve_step_s *= 2;
+      if (elapsed_s < (uint32_t) record.curve_count * record.curve_step_s) return;
+    }
+    record.curve[record.curve_count++] = depth <= 0 ? 0 : depth >= 255 ? 255 : (uint8_t)(depth + 0.5f);
+  }
+
+  // The drain starts, from the last depth sampled
+  void begin_drain(uint32_t ms) {
+    this->drain_start_ms_ = ms;
+    this->drain_low_ = this->last_depth_;
+  }
+
+  // Last depth sampled (NAN before the first)
+  float last_depth() const { return this->last_depth_; }
+
+  void set_flag(CycleFlag flag) { this->record_.flags |= flag; }
+  void set_error(float error) { this->record_.error_dmm = to_dmm(error); }
+
+  // Seconds spent in a phase that just ended
+  void set_fill_s(uint32_t ms) { this->record_.fill_s = clamp_s(ms); }
+  void set_soak_s(uint32_t ms) { this->record_.soak_s = clamp_s(ms); }
+  void set_drain_s(uint32_t ms) { this->record_.drain_s = clamp_s(ms); }
+
+  // Close the cycle and hand back its record
+  const CycleRecord &finish() {
+    this->active_ = false;
+    return this->record_;
+  }
+
+ protected:
+  static int16_t to_dmm(float mm) {
+    float dmm = mm * 10.0f;
+    if (dmm > 32767) return 32767;
+    if (dmm < -32768) return -32768;
+    return (int16_t) dmm;
+  }
+  static uint16_t clamp_s(uint32_t ms) { return ms / 1000 > 65535 ? 65535 : ms / 1000; }
+
+  CycleRecord record_;
+  uint32_t start_ms_ = 0;
+  uint32_t drain_start_ms_ = 0;
+  float drain_low_ = 0;
+  float last_depth_ = NAN;
+  bool active_ = false;
+};
+
+// Last N cycle records of a bin
+template<size_t N> class CycleLog {
+ public:
+  void push(const CycleRecord &record) {
+    this->records_[this->next_] = record;
+    this->next_ = (this->next_ + 1) % N;
+    if (this->count_ < N) this->count_++;
+  }
+
+  size_t size() const { return this->count_; }
+
+  // Oldest first
+  const CycleRecord &operator[](size_t i) const { return this->records_[(this->next_ + N - this->count_ + i) % N]; }
+
+ protected:
+  CycleRecord records_[N];
+  size_t next_ = 0;
+  size_t count_ = 0;
+};
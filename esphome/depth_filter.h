@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Streaming spike filter for ToF distance samples
+//
+// Splashes during a fill show up as single readings far from the surface.
+// Averaging them in lags the level and letting them through stops the pump
+// early. HampelFilter compares each sample with the median of the last W
+// accepted samples and rejects it when it is further away than k scaled
+// median absolute deviations (with a floor for a perfectly still surface),
+// holding the last accepted value instead. A rejected sample that the next
+// one agrees with is a real level change, not a splash: the window restarts
+// at the new level, so a step is delayed by at most one sample.
+//
+// Fixed storage, no allocation, O(W) per sample (two nth_element passes).
+template<size_t W> class HampelFilter {
+  static_assert(W >= 3 && W % 2 == 1, "HampelFilter window must be odd and at least 3");
+
+ public:
+  explicit HampelFilter(float k = 3.0f, float min_deviation = 4.0f) : k_(k), min_deviation_(min_deviation) {}
+
+  void reset() {
+    this->count_ = 0;
+    this->pending_ = false;
+  }
+
+  // Filter one sample; NaN (failed reading) passes through untouched
+  float apply(float x) {
+    if (std::isnan(x)) return x;
+    if (this->count_ < 3) return this->accept(x);
+
+    float median, deviation;
+    this->window_stats(median, deviation);
+    float threshold = std::max(this->k_ * 1.4826f * deviation, this->min_deviation_);
+    if (std::fabs(x - median) <= threshold) {
+      this->pending_ = false;
+      return this->accept(x);
+    }
+
+    // Second outlier in a row close to the first: the level moved, so the
+    // window restarts full at the new level
+    if (this->pending_ && std::fabs(x - this->pending_value_) <= threshold) {
+      this->pending_ = false;
+      for (size_t i = 0; i < W; i++) this->accept(i % 2 ? x : this->pending_value_);
+      return this->accept(x);
+    }
+
+    this->pending_ = true;
+    this->pending_value_ = x;
+    this->rejected_++;
+    return this->last_;
+  }
+
+  // Last accepted sample
+  float value() const { return this->last_; }
+  uint32_t rejected() const { return this->rejected_; }
+
+ protected:
+  float accept(float x) {
+    this->window_[this->next_] = x;
+    this->next_ = (this->next_ + 1) % W;
+    if (this->count_ < W) this->count_++;
+    this->last_ = x;
+    return x;
+  }
+
+  // Median of the window and median absolute deviation from it
+  void window_stats(float &median, float &deviation) const {
+    float scratch[W];
+    size_t mid = this->count_ / 2;
+    for (size_t i = 0; i < this->count_; i++) {
+      scratch[i] = this->window_[(this->next_ + W - 1 - i) % W];
+    }
+    std::nth_element(scratch, scratch + mid, scratch + this->count_);
+    median = scratch[mid];
+    for (size_t i = 0; i < this->count_; i++) {
+      scratch[i] = std::fabs(scratch[i] - median);
+    }
+    std::nth_element(scratch, scratch + mid, scratch + this->count_);
+    deviation = scratch[mid];
+  }
+
+  float k_;
+  float min_deviation_;
+  float window_[W] = {0};
+  size_t next_ = 0;
+  size_t count_ = 0;
+  float last_ = NAN;
+  bool pending_ = false;
+  float pending_value_ = 0;
+  uint32_t rejected_ = 0;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Drain completion from the depth trend
+//
+// Waiting for the depth to reach an empty threshold runs the pump dry for
+// minutes when the empty calibration is a few mm off, or stops it early the
+// other way. The level stops falling when the tray is empty whatever the
+// calibration says, so DrainPlateau watches the fall rate instead. It fits a
+// least-squares slope over the last few seconds and reports a plateau once
+// the rate stays under a threshold. Samples are averaged into one-second
+// buckets, so the window is bounded by MAX_WINDOW_S buckets whatever the
+// sample rate, and sensor noise averages out before the fit.
+//
+// A slow drain creeps down to the threshold rate over a long tail, where
+// noise alone can take a fit under it while water still flows. So the window
+// stretches with how slow the drain is: by the factor its fastest fall falls
+// short of SLOW_DRAIN_RATIO times the threshold, which averages out more
+// noise where the rate changes slowly. The rate then has to stay under the
+// threshold for HOLD_S seconds in a row.
+
+class DrainPlateau {
+ public:
+  static const size_t MAX_WINDOW_S = 60;
+  static constexpr float SLOW_DRAIN_RATIO = 6.0f;
+  static const uint32_t HOLD_S = 6;
+
+  // Start watching a new drain
+  void reset() {
+    this->count_ = 0;
+    this->bucket_sum_ = 0;
+    this->bucket_samples_ = 0;
+    this->started_ = false;
+    this->buckets_ = 0;
+    this->checked_ = 0;
+    this->held_s_ = 0;
+    this->peak_rate_ = 0;
+  }
+
+  void add_sample(uint32_t ms, float depth) {
+    if (!this->started_) {
+      this->started_ = true;
+      this->bucket_ms_ = ms;
+    }
+    // Close every bucket the sample is past; a gap repeats the last mean,
+    // for no more seconds than the window holds
+    uint32_t behind_s = (ms - this->bucket_ms_) / 1000;
+    if (behind_s > MAX_WINDOW_S) this->bucket_ms_ += (behind_s - MAX_WINDOW_S) * 1000;
+    while (ms - this->bucket_ms_ >= 1000) {
+      if (this->bucket_samples_ > 0) this->last_ = this->bucket_sum_ / this->bucket_samples_;
+      if (this->count_ == 0) this->first_ = this->last_;
+      this->push(this->last_);
+      this->bucket_sum_ = 0;
+      this->bucket_samples_ = 0;
+      this->bucket_ms_ += 1000;
+    }
+    this->bucket_sum_ += depth;
+    this->bucket_samples_++;
+  }
+
+  // Fall rate in mm/s over the last window_s seconds (positive while the
+  // level drops); false until that many seconds are in
+  bool fall_rate(size_t window_s, float &rate) const {
+    if (window_s < 2 || window_s > MAX_WINDOW_S || this->count_ < window_s) return false;
+    float sum_t = 0, sum_d = 0, sum_tt = 0, sum_td = 0;
+    for (size_t i = 0; i < window_s; i++) {
+      float t = -(float) i;
+      float d = this->means_[(this->next_ + MAX_WINDOW_S - 1 - i) % MAX_WINDOW_S];
+      sum_t += t;
+      sum_d += d;
+      sum_tt += t * t;
+      sum_td += t * d;
+    }
+    float n = window_s;
+    rate = -(n * sum_td - sum_t * sum_d) / (n * sum_tt - sum_t * sum_t);
+    return true;
+  }
+
+  // How far the level has dropped from the drain's first second to its last
+  float fallen() const { return this->count_ > 0 ? this->first_ - this->last_ : 0; }
+
+  // True once the level has dropped by at least min_fall_mm, so the pump has
+  // moved water, and then fell slower than rate_mm_s over window_s seconds,
+  // stretched for a slow drain, for HOLD_S seconds. Call with the same
+  // settings at least once a second.
+  bool plateaued(size_t window_s, float rate_mm_s, float min_fall_mm) {
+    for (; this->checked_ < this->buckets_; this->checked_++) {
+      float rate;
+      if (this->fall_rate(window_s, rate) && rate > this->peak_rate_) this->peak_rate_ = rate;
+      size_t window = window_s;
+      if (this->peak_rate_ > 0 && this->peak_rate_ < SLOW_DRAIN_RATIO * rate_mm_s) {
+        float stretched = window_s * SLOW_DRAIN_RATIO * rate_mm_s / this->peak_rate_;
+        window = stretched < MAX_WINDOW_S ? (size_t) stretched : MAX_WINDOW_S;
+      }
+      bool below = this->fallen() >= min_fall_mm && this->fall_rate(window, rate) && rate < rate_mm_s;
+      this->held_s_ = below ? this->held_s_ + 1 : 0;
+    }
+    return this->held_s_ >= HOLD_S;
+  }
+
+ protected:
+  void push(float mean) {
+    this->means_[this->next_] = mean;
+    this->next_ = (this->next_ + 1) % MAX_WINDOW_S;
+    if (this->count_ < MAX_WINDOW_S) this->count_++;
+    this->buckets_++;
+  }
+
+  float means_[MAX_WINDOW_S] = {0};
+  size_t next_ = 0;
+  size_t count_ = 0;
+  uint32_t bucket_ms_ = 0;
+  float bucket_sum_ = 0;
+  uint16_t bucket_samples_ = 0;
+  float first_ = 0;
+  float last_ = 0;
+  bool started_ = false;
+  uint32_t buckets_ = 0;  // buckets closed, and those plateaued() has looked at
+  uint32_t checked_ = 0;
+  uint32_t held_s_ = 0;   // seconds in a row under the rate
+  float peak_rate_ = 0;   // fastest fall over window_s so far
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Empty distance calibration from idle readings
+//
+// The empty distance (sensor to the dry tray) is set by hand, and a few mm of
+// drift, from condensation on the sensor window or a tray that sags, skews
+// every fill target and drain check after it. EmptyCalibrator keeps running
+// statistics of the distance while a bin is verifiably dry: idle, after a
+// drain that reached empty rather than levelling off or timing out, and
+// DRY_SETTLE_MS since for the tray to drip dry. A drain that levels off may
+// have water trapped above the pickup, so it teaches nothing. Samples are
+// summed into sessions of up to SESSION_SAMPLES (mean and variance,
+// Welford); a steady session is kept, and the estimate is the median of the
+// last HISTORY session means, so memory is fixed however long the bin
+// idles. Confidence grows with the sessions kept and falls with their
+// spread. The baseline only moves once the estimate is confident and at
+// least HYSTERESIS_MM away from it, so noise never walks it.
+//
+// A sample more than MAX_OFFSET_MM from the baseline isn't a dry tray (water
+// left in it, something over the sensor) and throws its session away; drift
+// that large is left to a hand calibration. A baseline changed by hand
+// restarts the statistics from it.
+
+class EmptyCalibrator {
+ public:
+  static const uint32_t DRY_SETTLE_MS = 10 * 60 * 1000;
+  static const uint16_t SESSION_SAMPLES = 120;     // 10 min at the 5 s idle rate
+  static const uint16_t MIN_SESSION_SAMPLES = 60;  // kept if a cycle cuts it short
+  static const size_t HISTORY = 8;
+  static constexpr float MAX_SESSION_STDDEV_MM = 3.0f;
+  static constexpr float MAX_SPREAD_MM = 4.0f;  // session means this far apart are no confidence
+  static constexpr float MAX_OFFSET_MM = 10.0f;
+  static constexpr float HYSTERESIS_MM = 1.5f;
+  static constexpr float MIN_CONFIDENCE = 0.75f;
+
+  // A cycle is running: not dry until a drain reaches empty. A session long
+  // enough is kept; the baseline isn't touched.
+  void wet() {
+    this->close_session();
+    this->dry_ = false;
+  }
+
+  // A drain reached empty at ms: dry once the tray has settled
+  void drained(uint32_t ms) {
+    this->reset_session();
+    this->dry_ = true;
+    this->settled_ = false;
+    this->dry_since_ms_ = ms;
+  }
+
+  // An idle distance sample and the empty distance in use; true if the
+  // confidence may have changed
+  bool add_sample(uint32_t ms, float distance, float baseline) {
+    if (std::isnan(baseline)) return false;
+    bool changed = false;
+    if (!this->has_baseline_ || fabsf(baseline - this->baseline_) > 0.05f) {
+      changed = this->history_count_ > 0;
+      this->history_count_ = 0;
+      this->next_ = 0;
+      this->reset_session();
+      this->baseline_ = baseline;
+      this->has_baseline_ = true;
+    }
+    if (!this->dry_ || std::isnan(distance)) return changed;
+    if (!this->settled_) {
+      if (ms - this->dry_since_ms_ < DRY_SETTLE_MS) return changed;
+      this->settled_ = true;
+    }
+    if (fabsf(distance - baseline) > MAX_OFFSET_MM) {
+      this->reset_session();
+      return changed;
+    }
+    this->count_++;
+    float delta = distance - this->mean_;
+    this->mean_ += delta / this->count_;
+    this->m2_ += delta * (distance - this->mean_);
+    if (this->count_ >= SESSION_SAMPLES) return this->close_session() || changed;
+    return changed;
+  }
+
+  // Median of the kept session means, or NAN before the first
+  float estimate() const {
+    if (this->history_count_ == 0) return NAN;
+    float sorted[HISTORY];
+    for (size_t i = 0; i < this->history_count_; i++) {
+      float mean = this->history_[i];
+      size_t j = i;
+      for (; j > 0 && sorted[j - 1] > mean; j--) sorted[j] = sorted[j - 1];
+      sorted[j] = mean;
+    }
+    size_t middle = this->history_count_ / 2;
+    return this->history_count_ % 2 ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) / 2;
+  }
+
+  // 0..1: the share of HISTORY kept, less the sessions' spread
+  float confidence() const {
+    if (this->history_count_ == 0) return 0;
+    float low = this->history_[0], high = this->history_[0];
+    for (size_t i = 1; i < this->history_count_; i++) {
+      low = fminf(low, this->history_[i]);
+      high = fmaxf(high, this->history_[i]);
+    }
+    float confidence = (float) this->history_count_ / HISTORY * (1 - (high - low) / MAX_SPREAD_MM);
+    return confidence > 0 ? confidence : 0;
+  }
+
+  // The empty distance to move to, once the estimate is confident and far
+  // enough from the baseline
+  bool propose(float &mm) const {
+    if (!this->has_baseline_ || this->confidence() < MIN_CONFIDENCE) return false;
+    float estimate = this->estimate();
+    if (fabsf(estimate - this->baseline_) < HYSTERESIS_MM) return false;
+    mm = roundf(estimate * 10) / 10;
+    return true;
+  }
+
+  // The empty distance was moved to mm
+  void moved(float mm) { this->baseline_ = mm; }
+
+ protected:
+  void reset_session() {
+    this->count_ = 0;
+    this->mean_ = 0;
+    this->m2_ = 0;
+  }
+
+  // Keep the session's mean if it is long and steady enough
+  bool close_session() {
+    bool keep = this->count_ >= MIN_SESSION_SAMPLES &&
+                sqrtf(this->m2_ / (this->count_ - 1)) <= MAX_SESSION_STDDEV_MM;
+    if (keep) {
+      this->history_[this->next_] = this->mean_;
+      this->next_ = (this->next_ + 1) % HISTORY;
+      if (this->history_count_ < HISTORY) this->history_count_++;
+    }
+    this->reset_session();
+    return keep;
+  }
+
+  float history_[HISTORY] = {0};
+  size_t next_ = 0;
+  size_t history_count_ = 0;
+  uint16_t count_ = 0;
+  float mean_ = 0;
+  float m2_ = 0;
+  float baseline_ = 0;
+  uint32_t dry_since_ms_ = 0;
+  bool has_baseline_ = false;
+  bool dry_ = false;
+  bool settled_ = false;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Predictive fill cutoff
+//
+// Stopping when the measured depth reaches target always overshoots: the
+// sample that crosses target is already old, the pump takes time to stop, and
+// water in the tubing keeps coming after it does. FillPredictor fits the rise
+// rate over the last few depth samples and asks for the stop as soon as the
+// level, projected over that lead time, would reach target.
+// FillCompensation learns the lead time from each cycle's measured stop
+// latency and settled depth error.
+
+// Least-squares rise rate over a short ring of depth samples
+class FillPredictor {
+ public:
+  static const size_t WINDOW = 16;
+
+  void reset() { this->count_ = 0; }
+
+  void add_sample(uint32_t ms, float depth) {
+    this->ms_[this->next_] = ms;
+    this->depth_[this->next_] = depth;
+    this->next_ = (this->next_ + 1) % WINDOW;
+    if (this->count_ < WINDOW) this->count_++;
+  }
+
+  // Rise rate in mm/s (0 until there are enough samples or while falling)
+  float rise_rate() const {
+    float slope, depth;
+    if (!this->fit(slope, depth)) return 0;
+    return slope > 0 ? slope * 1000.0f : 0;
+  }
+
+  // Depth at the newest sample, smoothed by the fit
+  float current_depth() const {
+    float slope, depth;
+    if (this->fit(slope, depth)) return depth;
+    return this->count_ > 0 ? this->depth_[(this->next_ + WINDOW - 1) % WINDOW] : 0;
+  }
+
+  // True once the level, projected lead_ms ahead, reaches target
+  bool should_stop(float target, float lead_ms) const {
+    return this->current_depth() + this->rise_rate() * lead_ms / 1000.0f >= target;
+  }
+
+ protected:
+  // Fit depth = depth_at_newest + slope * (t - t_newest), slope in mm/ms
+  bool fit(float &slope, float &depth_at_newest) const {
+    if (this->count_ < 4) return false;
+    size_t newest = (this->next_ + WINDOW - 1) % WINDOW;
+    float sum_t = 0, sum_d = 0, sum_tt = 0, sum_td = 0;
+    for (size_t i = 0; i < this->count_; i++) {
+      size_t slot = (newest + WINDOW - i) % WINDOW;
+      float t = -(float) (uint32_t)(this->ms_[newest] - this->ms_[slot]);
+      float d = this->depth_[slot];
+      sum_t += t;
+      sum_d += d;
+      sum_tt += t * t;
+      sum_td += t * d;
+    }
+    float n = this->count_;
+    float denom = n * sum_tt - sum_t * sum_t;
+    if (denom <= 0) return false;
+    slope = (n * sum_td - sum_t * sum_d) / denom;
+    depth_at_newest = (sum_d - slope * sum_t) / n;
+    return true;
+  }
+
+  uint32_t ms_[WINDOW] = {0};
+  float depth_[WINDOW] = {0};
+  size_t next_ = 0;
+  size_t count_ = 0;
+};
+
+// Lead time learned across cycles: the measured stop latency plus a coast
+// term fitted from how far each fill settled above or below target
+class FillCompensation {
+ public:
+  // Lead time to project the rise over, for a sensor sampled every sample_ms
+  float lead_ms(uint32_t sample_ms) const { return this->latency_ms_ + this->coast_ms_ + sample_ms / 2.0f; }
+
+  // Fold in one cycle's decision-to-pump-off latency
+  void learn_latency(uint32_t latency_ms) { this->latency_ms_ += (latency_ms - this->latency_ms_) * 0.25f; }
+
+  // Fold in one cycle's settled error (mm above target) at the stop rise rate
+  void learn_error(float error_mm, float rate_mm_s) {
+    if (rate_mm_s <= 0.1f) return;
+    this->coast_ms_ += error_mm / rate_mm_s * 1000.0f * 0.5f;
+    if (this->coast_ms_ < 0) this->coast_ms_ = 0;
+    if (this->coast_ms_ > MAX_COAST_MS) this->coast_ms_ = MAX_COAST_MS;
+  }
+
+  float latency_ms() const { return this->latency_ms_; }
+  float coast_ms() const { return this->coast_ms_; }
+
+ protected:
+  static constexpr float MAX_COAST_MS = 10000;
+
+  float latency_ms_ = 100;
+  float coast_ms_ = 0;
+};
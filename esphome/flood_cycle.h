@@ -0,0 +1,73 @@
+#pragma once
+
+#include "bin_set.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Flood cycle state machine
+//
+// Every bin runs the same cycle: fill with the pump reversed, soak with it
+// off, drain with it forward. The cycle is the step table below rather than a
+// script per bin, so adding a bin adds a table entry and two bytes of state,
+// not another copy of the steps. Each step lasts its duration from the bin
+// table, on a timer of the shelf's timer wheel; a step the bin ends on depth
+// (CycleEnd::DEPTH) ends as soon as the depth check is met, with the duration
+// as its timeout. The helpers do the pump switching and phase publishing on
+// each step change (enter_cycle_step() in flood_helpers.h).
+
+struct CycleStep {
+  PumpPhase phase;               // phase of the bin during the step
+  float (*BinRefs::*minutes)();  // duration, or timeout of a depth-ended step
+  float default_minutes;         // for a bin whose table doesn't set it
+};
+
+// Steps in order; CycleStepIndex names them
+enum CycleStepIndex : uint8_t { CYCLE_FILL, CYCLE_SOAK, CYCLE_DRAIN };
+static const CycleStep FLOOD_CYCLE_STEPS[] = {
+    {PumpPhase::FILLING, &BinRefs::fill_duration, 5.0f},
+    {PumpPhase::SOAKING, &BinRefs::soak_duration, 30.0f},
+    {PumpPhase::DRAINING, &BinRefs::drain_duration, 10.0f},
+};
+static const uint8_t FLOOD_CYCLE_STEP_COUNT = sizeof(FLOOD_CYCLE_STEPS) / sizeof(FLOOD_CYCLE_STEPS[0]);
+
+// Where one bin is in its cycle
+class FloodCycle {
+ public:
+  static const uint8_t IDLE = 0xFF;
+
+  bool running() const { return this->step_ != IDLE; }
+
+  // Index into FLOOD_CYCLE_STEPS, or IDLE
+  uint8_t step() const { return this->step_; }
+
+  // Phase of the current step, IDLE once the cycle is over
+  PumpPhase phase() const { return this->running() ? FLOOD_CYCLE_STEPS[this->step_].phase : PumpPhase::IDLE; }
+
+  // Begin at the first step. A start while running is ignored and counted,
+  // as a script in single mode would ignore it.
+  bool start() {
+    if (this->running()) {
+      this->ignored_starts_++;
+      return false;
+    }
+    this->step_ = 0;
+    return true;
+  }
+
+  // Pick up at a step a reset interrupted (cycle_checkpoint.h)
+  void resume(uint8_t step) { this->step_ = step < FLOOD_CYCLE_STEP_COUNT ? step : IDLE; }
+
+  // Move on to the next step; false once the last one is done
+  bool advance() {
+    if (!this->running()) return false;
+    if (++this->step_ >= FLOOD_CYCLE_STEP_COUNT) this->step_ = IDLE;
+    return this->running();
+  }
+
+  uint16_t ignored_starts() const { return this->ignored_starts_; }
+
+ protected:
+  uint8_t step_ = IDLE;
+  uint16_t ignored_starts_ = 0;
+};
@@ -1,32 +1,110 @@
 #pragma once
 
 #include "esphome.h"
-#include <sstream>
-#include <vector>
-#include <algorithm>
+#include "flood_schedule.h"
+#include "bin_set.h"
+#include "pump_state.h"
+#include "flood_cycle.h"
+#include "cycle_checkpoint.h"
+#include "fill_predictor.h"
+#include "drain_plateau.h"
+#include "empty_calibrator.h"
+#include "depth_filter.h"
+#include "flood_journal.h"
+#include "cycle_telemetry.h"
+#include "flood_metrics.h"
+#include "timer_wheel.h"
+#include "shelf_state.h"
+#include "shelf_clock.h"
 
-// Speed conversion function
-float speed_to_level(const std::string& speed) {
-  if (speed == "55%") return 0.55;
-  if (speed == "65%") return 0.65;
-  if (speed == "75%") return 0.75;
-  if (speed == "85%") return 0.85;
-  if (speed == "100%") return 1.0;
-  return 0.65; // default
+#if defined(USE_ESP32) && defined(CONFIG_PM_ENABLE)
+#include <esp_pm.h>
+#endif
+
+// The config's bin table (FLOOD_BIN_COUNT and bins) comes from its *_bins.h,
+// which must be included before this header
+#ifndef FLOOD_BIN_COUNT
+#error "include the config's *_bins.h before flood_helpers.h"
+#endif
+
+// Output level (0..1) of a bin's fill or drain speed, set in percent
+float get_speed_level(int bin_num, float (*BinRefs::*speed)(), float fallback) {
+  float percent = bins.get(bin_num, speed, fallback * 100.0f);
+  if (std::isnan(percent)) return fallback;
+  return percent < 0 ? 0.0f : percent > 100 ? 1.0f : percent / 100.0f;
+}
+
+// Level of a bin's pump in a direction: the reverse direction runs at the
+// drain speed, forward at the fill speed
+float get_pump_level(int bin_num, bool reverse) {
+  return reverse ? get_speed_level(bin_num, &BinRefs::drain_speed, 0.75f)
+                 : get_speed_level(bin_num, &BinRefs::fill_speed, 0.65f);
+}
+
+// Groups pump output changes: on a shelf with driver boards the last batch
+// to close flushes them, one bus write per chip however many pumps changed.
+// Nests; costs nothing on direct outputs.
+class PumpOutputBatch {
+ public:
+  PumpOutputBatch() { depth_++; }
+  ~PumpOutputBatch() {
+    if (--depth_ == 0) shelf.flush();
+  }
+
+ protected:
+  static int depth_;
+};
+int PumpOutputBatch::depth_ = 0;
+
+// Ramp a bin's speed output to level over ms, in hardware where the drive
+// can fade, else at once
+void ramp_pump_level(int bin_num, float level, uint32_t ms) {
+  if (!bins.contains(bin_num)) return;
+  if (ledc_fade_to(bins[bin_num].drive, level, ms)) return;
+  if (bins[bin_num].set_speed_level != nullptr) bins[bin_num].set_speed_level(level);
+}
+
+// Start a bin's pump in the direction of its reverse switch, soft-starting
+// from standstill
+void pump_start(int bin_num) {
+  if (!bins.contains(bin_num)) return;
+  PumpOutputBatch batch;
+  const BinRefs &bin = bins[bin_num];
+  bool reverse = bins.get(bin_num, &BinRefs::reverse, false);
+  if (bin.set_direction != nullptr) bin.set_direction(!reverse, reverse);
+  ramp_pump_level(bin_num, get_pump_level(bin_num, reverse), bin.drive.soft_start_ms);
+}
+
+// Soft-stop a bin's pump. The bridge is off once the enable duty reaches
+// zero, so the direction pins are left alone while it ramps; without a
+// hardware fade they are released at once as before.
+void pump_stop(int bin_num) {
+  if (!bins.contains(bin_num)) return;
+  PumpOutputBatch batch;
+  const BinRefs &bin = bins[bin_num];
+  if (ledc_fade_to(bin.drive, 0.0f, bin.drive.soft_stop_ms)) return;
+  if (bin.set_direction != nullptr) bin.set_direction(false, false);
+  if (bin.set_speed_level != nullptr) bin.set_speed_level(0.0f);
+}
+
+// Soft-stop time of a bin's pump, for the pause before a direction change
+uint32_t get_pump_stop_ms(int bin_num) {
+  return bins.contains(bin_num) ? bins[bin_num].drive.soft_stop_ms : 0;
+}
+
+// Speed setting changed: ramp a running pump to it
+void update_pump_speed(int bin_num) {
+  if (!bins.get(bin_num, &BinRefs::pump_on, false)) return;
+  PumpOutputBatch batch;
+  bool reverse = bins.get(bin_num, &BinRefs::reverse, false);
+  ramp_pump_level(bin_num, get_pump_level(bin_num, reverse), bins[bin_num].drive.soft_start_ms);
 }
 
 // Calculate actual water depth from sensor distance
 // Sensor measures distance to water surface, so:
 // water_depth = empty_distance - current_distance
 float calculate_water_depth(int bin_num, float sensor_distance) {
-  float empty_distance = 200.0; // default
-  
-  switch(bin_num) {
-    case 1: empty_distance = id(bin_1_empty_distance).state; break;
-    case 2: empty_distance = id(bin_2_empty_distance).state; break;
-    case 3: empty_distance = id(bin_3_empty_distance).state; break;
-    case 4: empty_distance = id(bin_4_empty_distance).state; break;
-  }
+  float empty_distance = bins.get(bin_num, &BinRefs::empty_distance, 200.0f);
   
   // Water depth = distance when empty - current distance to water
   float depth = empty_distance - sensor_distance;
@@ -40,46 +118,602 @@ float calculate_water_depth(int bin_num, float sensor_distance) {
 
 // Get target depth for a bin
 float get_target_depth(int bin_num) {
-  switch(bin_num) {
-    case 1: return id(bin_1_target_depth).state;
-    case 2: return id(bin_2_target_depth).state;
-    case 3: return id(bin_3_target_depth).state;
-    case 4: return id(bin_4_target_depth).state;
-    default: return 50.0;
+  return bins.get(bin_num, &BinRefs::target_depth, 50.0f);
+}
+
+// Phases of every pump, packed into one word
+static PumpStates<FLOOD_BIN_COUNT> pump_states;
+
+// millis() when each bin entered its current phase
+static uint32_t phase_started_ms[FLOOD_BIN_COUNT];
+
+// Helper function to get pump phase by number
+PumpPhase get_pump_phase(int pump_num) {
+  return pump_states.get(pump_num);
+}
+
+// Every timed event of the shelf, one timer each on a single wheel, so the
+// loop only does work when a deadline arrives
+enum FloodTimer : size_t {
+  TIMER_SCHEDULER,     // shelf scheduler: next window, or each minute while bins are queued
+  TIMER_COUNTDOWN,     // countdown sensors, each minute
+  TIMER_JOURNAL,       // batched schedule journal append
+  TIMER_SHELF_STATE,   // aggregated shelf state publish
+  TIMER_BIN_SCHEDULE,  // per-bin schedule of bin 1; bin n is TIMER_BIN_SCHEDULE + n - 1
+  TIMER_CYCLE = TIMER_BIN_SCHEDULE + FLOOD_BIN_COUNT,  // flood cycle step of bin 1, likewise
+};
+static TimerWheel<TIMER_CYCLE + FLOOD_BIN_COUNT> flood_timers;
+
+// Wheel time, in whole seconds of millis()
+static uint32_t flood_timers_ms = 0;
+
+// Each bin's cycle step and deadline, kept across resets
+RTC_NOINIT_ATTR static CycleCheckpoint<FLOOD_BIN_COUNT> cycle_checkpoint;
+
+// The shelf's wall clock, and its time kept across resets
+static ShelfClock shelf_clock;
+RTC_NOINIT_ATTR static ClockCheckpoint clock_checkpoint;
+
+// The time to schedule by: whatever source set the system time last, else
+// the shelf clock running on from it or from before a reset; not valid
+// until either has a time
+ESPTime shelf_now() {
+  static bool rejected_logged = false;
+  uint32_t now_ms = millis();
+  auto system = id(homeassistant_time).now();
+  if (system.is_valid()) {
+    ClockSource was = shelf_clock.source();
+    int32_t step = shelf_clock.sync(system.timestamp, now_ms);
+    if (step == ShelfClock::NO_STEP) {
+      if (!rejected_logged) ESP_LOGW("clock", "Time source is behind the last known time, ignoring it");
+      rejected_logged = true;
+    } else if (was != ClockSource::SYNCED) {
+      ESP_LOGI("clock", "Clock synced, %+ld s from the resumed time", (long) step);
+    } else if (step > ShelfClock::STEP_LOG_S || step < -ShelfClock::STEP_LOG_S) {
+      ESP_LOGI("clock", "Clock stepped %+ld s", (long) step);
+    }
+  }
+  return ESPTime::from_epoch_local(shelf_clock.now(now_ms));
+}
+
+// Call from on_boot after restore_schedule_journal(): resume the clock from
+// before a reset, and reject any source earlier than the latest cycle start
+void restore_shelf_clock() {
+  time_t floor = 0;
+  for (int bin_num = 1; bin_num <= bins.size(); bin_num++) {
+    time_t last_cycle = bins.get(bin_num, &BinRefs::last_cycle, 0);
+    if (last_cycle > floor) floor = last_cycle;
+  }
+  shelf_clock.set_floor(floor);
+  time_t saved = clock_checkpoint.restore();
+  clock_checkpoint.clear();
+  shelf_clock.resume(saved, millis());
+  if (shelf_clock.source() == ClockSource::RESUMED) {
+    ESP_LOGI("clock", "Clock resumed from before the reset");
+  } else if (!shelf_clock.valid()) {
+    ESP_LOGI("clock", "No saved time, scheduling waits for a time source");
+  }
+}
+
+// Let the CPU light-sleep between loop passes, or hold it awake. Pump
+// outputs' LEDC timers stop in light sleep, so it is only allowed while every
+// pump is idle. Needs CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE
+// in sdkconfig; without them this does nothing.
+void allow_light_sleep(bool allow) {
+#if defined(USE_ESP32) && defined(CONFIG_PM_ENABLE)
+  static esp_pm_lock_handle_t awake_lock = nullptr;
+  static bool held = false;
+  if (awake_lock == nullptr) {
+    esp_pm_config_t config = {};
+    config.max_freq_mhz = 240;
+    config.min_freq_mhz = 80;
+    config.light_sleep_enable = true;
+    if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "flood", &awake_lock) != ESP_OK ||
+        esp_pm_configure(&config) != ESP_OK) {
+      ESP_LOGW("power", "Light sleep unavailable");
+      return;
+    }
+  }
+  if (allow && held) esp_pm_lock_release(awake_lock);
+  if (!allow && !held) esp_pm_lock_acquire(awake_lock);
+  held = !allow;
+#else
+  (void) allow;
+#endif
+}
+
+// Timer tick: every second, or stretched to the next deadline while the
+// shelf idles in low-power mode; the main loop then sleeps up to
+// IDLE_LOOP_MAX_MS between passes and still wakes at once for API traffic
+static const uint32_t FLOOD_TICK_MS = 1000;
+static const uint32_t DEFAULT_LOOP_MS = 16;
+static const uint32_t IDLE_LOOP_MAX_MS = 5000;
+static uint32_t flood_tick_ms = FLOOD_TICK_MS;
+
+void set_flood_tick_ms(uint32_t ms) {
+  if (ms == flood_tick_ms) return;
+  bool idle = ms > FLOOD_TICK_MS;
+  if (idle != (flood_tick_ms > FLOOD_TICK_MS)) allow_light_sleep(idle);
+  flood_tick_ms = ms;
+  shelf.set_tick(ms);
+  App.set_loop_interval(idle ? (ms < IDLE_LOOP_MAX_MS ? ms : IDLE_LOOP_MAX_MS) : DEFAULT_LOOP_MS);
+}
+
+// Bring the wheel up to millis() and run whatever is due
+static bool advancing_timers = false;
+void advance_flood_timers() {
+  uint32_t elapsed_s = (millis() - flood_timers_ms) / 1000;
+  flood_timers_ms += elapsed_s * 1000;
+  advancing_timers = true;
+  flood_timers.advance_to(flood_timers.now() + elapsed_s);
+  advancing_timers = false;
+  cycle_checkpoint.set_tick(flood_timers.now());
+}
+
+// (Re)arm a shelf timer. Between stretched ticks the wheel is first brought
+// up to date, so the delay counts from now rather than from the last tick,
+// and the tick is cut back to a second if the timer is due before the next.
+void arm_flood_timer(size_t timer, uint32_t delay_s, void (*callback)(int), int arg) {
+  if (flood_tick_ms > FLOOD_TICK_MS && !advancing_timers) advance_flood_timers();
+  flood_timers.arm(timer, delay_s, callback, arg);
+  if (delay_s * 1000 < flood_tick_ms) set_flood_tick_ms(FLOOD_TICK_MS);
+}
+
+void update_idle_tick();
+
+// Call from the tick interval: advance the wheel, then plan the next tick
+void service_timers() {
+  advance_flood_timers();
+  update_idle_tick();
+  // The clock's time for the next boot, good for as long as the next tick
+  ESPTime now = shelf_now();
+  if (now.is_valid()) clock_checkpoint.save(now.timestamp, flood_tick_ms / 1000);
+}
+
+void shelf_scheduler_timer(int);
+void journal_timer(int);
+void end_cycle_step(int bin_num);
+
+// Run the shelf scheduler on the next tick, if it is in use
+void wake_shelf_scheduler() {
+  if (flood_timers.armed(TIMER_SCHEDULER) && flood_timers.remaining(TIMER_SCHEDULER) > 1) {
+    arm_flood_timer(TIMER_SCHEDULER, 1, shelf_scheduler_timer, 0);
+  }
+}
+
+// Scheduling state changed: have the journal look at it on the next tick
+void note_schedule_change() {
+  if (!flood_timers.armed(TIMER_JOURNAL)) {
+    arm_flood_timer(TIMER_JOURNAL, 1, journal_timer, 0);
+  }
+}
+
+// Phase, depth and next start of every bin, published as one entity
+static ShelfState<FLOOD_BIN_COUNT> aggregated_shelf_state;
+static uint32_t shelf_state_publishes = 0;
+
+// Publish the shelf state now
+void publish_shelf_state() {
+  shelf.publish(aggregated_shelf_state.format());
+  shelf_state_publishes++;
+}
+
+void shelf_state_timer(int) {
+  if (aggregated_shelf_state.dirty()) publish_shelf_state();
+}
+
+// Shelf state changed: publish it on the next tick, together with anything
+// else that changes before then
+void note_shelf_state_change() {
+  if (!flood_timers.armed(TIMER_SHELF_STATE)) {
+    arm_flood_timer(TIMER_SHELF_STATE, 1, shelf_state_timer, 0);
+  }
+}
+
+// ToF sampling rate: fast while the pump is moving water so the fill stops
+// close to target, slow while idle or soaking to keep I2C and CPU quiet
+static const uint32_t DEPTH_FAST_INTERVAL_MS = 50;
+static const uint32_t DEPTH_SLOW_INTERVAL_MS = 5000;
+// Age of a reading when on_value sees it: the VL6180X ranges for about 10 ms
+// and reports the level from the middle of that, then the I2C readout
+static const uint32_t DEPTH_SAMPLE_AGE_MS = 10;
+
+// Switch a bin's distance sensor to the rate its phase needs
+void apply_depth_sample_rate(int bin_num, PumpPhase phase) {
+  if (!bins.contains(bin_num) || bins[bin_num].set_sample_interval == nullptr) return;
+  bool moving = phase == PumpPhase::FILLING || phase == PumpPhase::DRAINING;
+  bins[bin_num].set_sample_interval(moving ? DEPTH_FAST_INTERVAL_MS : DEPTH_SLOW_INTERVAL_MS);
+}
+
+// Spike filter on every bin's distance sensor: 7 samples is 350 ms while
+// filling or draining and 35 s while idle
+static const size_t DEPTH_FILTER_WINDOW = 7;
+static HampelFilter<DEPTH_FILTER_WINDOW> distance_filters[FLOOD_BIN_COUNT];
+
+// Call from the distance sensor's lambda filter, so the sensor state and
+// everything reading it only ever sees filtered samples
+float filter_distance_sample(int bin_num, float distance) {
+  if (!bins.contains(bin_num)) return distance;
+  HampelFilter<DEPTH_FILTER_WINDOW> &filter = distance_filters[bin_num - 1];
+  uint32_t rejected = filter.rejected();
+  float filtered = filter.apply(distance);
+  if (filter.rejected() != rejected) {
+    ESP_LOGD("depth", "Bin %d: rejected %.1f mm reading, holding %.1f mm", bin_num, distance, filtered);
+  }
+  return filtered;
+}
+
+// Fill control per bin: rise-rate predictor for the current fill and the
+// lead time learned from previous ones
+struct FillControl {
+  FillPredictor predictor;
+  FillCompensation compensation;
+  uint32_t stop_requested_ms = 0;  // when the sample that asked for the stop was taken (0 = not yet)
+  uint32_t stopped_ms = 0;         // pump off, waiting for the level to settle
+  float rate_at_stop = 0;
+};
+static FillControl fill_control[FLOOD_BIN_COUNT];
+
+// Time after the fill stops before the level counts as settled
+static const uint32_t FILL_SETTLE_MS = 15000;
+
+// Reset the fill controller as a fill starts
+void begin_fill(int bin_num) {
+  FillControl &fill = fill_control[bin_num - 1];
+  fill.predictor.reset();
+  fill.stop_requested_ms = 0;
+  fill.stopped_ms = 0;
+}
+
+// Telemetry of each bin's cycle in progress and of its last few cycles
+static const size_t CYCLE_LOG_SIZE = 8;
+static CycleRecorder cycle_recorders[FLOOD_BIN_COUNT];
+static CycleLog<CYCLE_LOG_SIZE> cycle_logs[FLOOD_BIN_COUNT];
+
+// Depth at or below which a drained tray counts as empty
+static const float DRAIN_EMPTY_MM = 5.0f;
+
+// Drain trend per bin, for bins that end the drain on depth. The level has
+// to fall by DRAIN_MIN_FALL_MM before a plateau counts, so a pump still
+// priming its tubing isn't taken for an empty tray.
+static DrainPlateau drain_plateaus[FLOOD_BIN_COUNT];
+static const float DRAIN_MIN_FALL_MM = 2.0f;
+
+// A bin's drain plateau settings: the fall rate in mm/min under which the
+// tray counts as drained, and the seconds it is measured over
+float get_drain_plateau_rate(int bin_num) {
+  float rate = bins.get(bin_num, &BinRefs::drain_plateau_rate, 1.5f);
+  return std::isnan(rate) || rate <= 0 ? 1.5f : rate;
+}
+size_t get_drain_plateau_window_s(int bin_num) {
+  float window = bins.get(bin_num, &BinRefs::drain_plateau_window, 15.0f);
+  if (std::isnan(window)) return 15;
+  return window < 5 ? 5 : window > DrainPlateau::MAX_WINDOW_S ? DrainPlateau::MAX_WINDOW_S : (size_t) window;
+}
+
+// Empty distance learned from each bin's idle readings while it is dry, on
+// bins that drain by depth and whose config can set the empty distance
+static EmptyCalibrator empty_calibrators[FLOOD_BIN_COUNT];
+
+bool calibrates_empty_distance(int bin_num) {
+  return bins.contains(bin_num) && bins[bin_num].drain_end == CycleEnd::DEPTH &&
+         bins[bin_num].set_empty_distance != nullptr && bins.get(bin_num, &BinRefs::auto_calibrate, true);
+}
+
+// An idle sample: publish the calibrator's confidence when it changes, and
+// move the empty distance when the calibrator asks
+void calibrate_empty_distance(int bin_num, float distance) {
+  if (!calibrates_empty_distance(bin_num)) return;
+  EmptyCalibrator &calibrator = empty_calibrators[bin_num - 1];
+  float empty_distance = bins.get(bin_num, &BinRefs::empty_distance, NAN);
+  if (!calibrator.add_sample(millis(), distance, empty_distance)) return;
+  if (bins[bin_num].publish_calibration_confidence != nullptr) {
+    bins[bin_num].publish_calibration_confidence(calibrator.confidence() * 100);
+  }
+  float moved;
+  if (calibrator.propose(moved)) {
+    ESP_LOGI("calibration", "Bin %d: empty distance %.1f -> %.1f mm (confidence %.0f%%)", bin_num, empty_distance,
+             moved, calibrator.confidence() * 100);
+    bins[bin_num].set_empty_distance(moved);
+    calibrator.moved(moved);
+  }
+}
+
+// Call from the distance sensor's on_value
+void on_distance_sample(int bin_num, float distance) {
+  FLOOD_TIMED(TIMING_DEPTH);
+  if (!bins.contains(bin_num)) return;
+  FillControl &fill = fill_control[bin_num - 1];
+  PumpPhase phase = get_pump_phase(bin_num);
+  float depth = calculate_water_depth(bin_num, distance);
+  float target = get_target_depth(bin_num);
+  cycle_recorders[bin_num - 1].sample(millis(), depth);
+  if (aggregated_shelf_state.set_depth(bin_num, depth)) note_shelf_state_change();
+
+  if (phase == PumpPhase::FILLING) {
+    fill.predictor.add_sample(millis(), depth);
+    if (fill.stop_requested_ms == 0 &&
+        fill.predictor.should_stop(target, fill.compensation.lead_ms(DEPTH_FAST_INTERVAL_MS))) {
+      fill.stop_requested_ms = millis() - DEPTH_SAMPLE_AGE_MS;
+      fill.rate_at_stop = fill.predictor.rise_rate();
+      if (bins[bin_num].fill_end == CycleEnd::DEPTH) end_cycle_step(bin_num);
+    }
+    return;
+  }
+
+  // Drain until the tray is empty or the level stops falling, on bins that
+  // drain by depth
+  if (phase == PumpPhase::DRAINING) {
+    if (bins[bin_num].drain_end != CycleEnd::DEPTH) return;
+    DrainPlateau &plateau = drain_plateaus[bin_num - 1];
+    plateau.add_sample(millis(), depth);
+    if (depth <= DRAIN_EMPTY_MM) {
+      empty_calibrators[bin_num - 1].drained(millis());
+      end_cycle_step(bin_num);
+    } else if (plateau.plateaued(get_drain_plateau_window_s(bin_num), get_drain_plateau_rate(bin_num) / 60.0f,
+                                 DRAIN_MIN_FALL_MM)) {
+      // Not proof the tray is dry: water trapped above the pickup levels off
+      // too, and learning it as empty would read every depth low after
+      ESP_LOGI("drain", "Bin %d: level flat at %.1f mm after falling %.1f mm, drain done", bin_num, depth,
+               plateau.fallen());
+      end_cycle_step(bin_num);
+    }
+    return;
+  }
+
+  // Idle after a drain that reached empty: the tray is dry
+  if (phase == PumpPhase::IDLE) {
+    calibrate_empty_distance(bin_num, distance);
+    return;
+  }
+
+  // First sample once the level has settled: report and learn the error
+  if (phase == PumpPhase::SOAKING && fill.stopped_ms != 0 && millis() - fill.stopped_ms >= FILL_SETTLE_MS) {
+    fill.stopped_ms = 0;
+    float error = depth - target;
+    fill.compensation.learn_error(error, fill.rate_at_stop);
+    cycle_recorders[bin_num - 1].set_error(error);
+    ESP_LOGI("fill", "Bin %d: settled at %.1f mm, %s %.1f mm (rate %.2f mm/s, lead %.0f ms)", bin_num, depth,
+             error >= 0 ? "overshoot" : "undershoot", error >= 0 ? error : -error, fill.rate_at_stop,
+             fill.compensation.lead_ms(DEPTH_FAST_INTERVAL_MS));
+    if (bins[bin_num].publish_fill_error != nullptr) {
+      bins[bin_num].publish_fill_error(error);
+    }
+  }
+}
+
+// Called right after the pump is switched off at the end of a fill: publishes
+// the stop latency, from the sample that asked for the stop to the pump
+// standing still at the end of its soft-stop ramp, and starts the settle
+// timer for the overshoot measurement
+void record_fill_stop(int bin_num) {
+  if (!bins.contains(bin_num)) return;
+  FillControl &fill = fill_control[bin_num - 1];
+  fill.stopped_ms = millis();
+  if (fill.stop_requested_ms == 0) {
+    fill.rate_at_stop = 0;
+    cycle_recorders[bin_num - 1].set_flag(CYCLE_FILL_TIMEOUT);
+    ESP_LOGW("fill", "Bin %d: fill stopped by timeout before reaching target", bin_num);
+    return;
+  }
+  uint32_t latency = millis() - fill.stop_requested_ms + get_pump_stop_ms(bin_num);
+  fill.compensation.learn_latency(latency);
+  ESP_LOGI("fill", "Bin %d: pump stopped %u ms after the stop was requested", bin_num, (unsigned) latency);
+  if (bins[bin_num].publish_stop_latency != nullptr) {
+    bins[bin_num].publish_stop_latency(latency);
+  }
+}
+
+// Status publishes per bin sent to the API
+static uint32_t status_publishes[FLOOD_BIN_COUNT];
+
+// Push a bin's status text to Home Assistant
+void publish_pump_status(int pump_num) {
+  if (!bins.contains(pump_num) || bins[pump_num].publish_status == nullptr) return;
+  bins[pump_num].publish_status(pump_phase_text(get_pump_phase(pump_num)));
+  status_publishes[pump_num - 1]++;
+}
+
+// Publish every bin's status once, e.g. from on_boot
+void publish_all_pump_status() {
+  for (int pump_num = 1; pump_num <= bins.size(); pump_num++) {
+    publish_pump_status(pump_num);
+  }
+}
+
+// Close the phase a bin's cycle just left in its telemetry, and start or
+// finish the cycle record
+void record_cycle_phase(int bin_num, PumpPhase previous, PumpPhase phase, uint32_t previous_ms) {
+  CycleRecorder &recorder = cycle_recorders[bin_num - 1];
+  if (phase == PumpPhase::FILLING) {
+    auto now = shelf_now();
+    recorder.begin(millis(), now.is_valid() ? (uint32_t) now.timestamp : 0, get_target_depth(bin_num));
+    return;
+  }
+  if (!recorder.active()) return;
+
+  if (previous == PumpPhase::FILLING) recorder.set_fill_s(previous_ms);
+  if (previous == PumpPhase::SOAKING) recorder.set_soak_s(previous_ms);
+  if (previous == PumpPhase::DRAINING) recorder.set_drain_s(previous_ms);
+  if (phase == PumpPhase::DRAINING) recorder.begin_drain(millis());
+
+  if (phase == PumpPhase::IDLE || phase == PumpPhase::FAULT) {
+    if (previous == PumpPhase::DRAINING && recorder.last_depth() > DRAIN_EMPTY_MM) {
+      recorder.set_flag(CYCLE_DRAIN_TIMEOUT);
+    }
+    cycle_logs[bin_num - 1].push(recorder.finish());
   }
 }
 
-// Helper function to get pump state by number
-std::string get_pump_state(int pump_num) {
-  switch(pump_num) {
-    case 1: return id(pump_1_state);
-    case 2: return id(pump_2_state);
-    case 3: return id(pump_3_state);
-    case 4: return id(pump_4_state);
-    default: return "Unknown";
+// Log every bin's recorded cycles, oldest first, one compact line each:
+// times in seconds, depths in mm, the curve as one hex byte (mm) per step
+void dump_cycle_telemetry() {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  char curve[CycleRecord::CURVE_POINTS * 2 + 1];
+  for (int bin_num = 1; bin_num <= bins.size(); bin_num++) {
+    const CycleLog<CYCLE_LOG_SIZE> &log = cycle_logs[bin_num - 1];
+    for (size_t i = 0; i < log.size(); i++) {
+      const CycleRecord &record = log[i];
+      for (size_t point = 0; point < record.curve_count; point++) {
+        curve[point * 2] = HEX_DIGITS[record.curve[point] >> 4];
+        curve[point * 2 + 1] = HEX_DIGITS[record.curve[point] & 0xF];
+      }
+      curve[record.curve_count * 2] = '\0';
+      ESP_LOGI("telemetry",
+               "bin=%d start=%u fill=%u soak=%u drain=%u plateau=%u target=%.1f peak=%.1f error=%+.1f flags=%u "
+               "step=%u curve=%s",
+               bin_num, (unsigned) record.start_time, record.fill_s, record.soak_s, record.drain_s,
+               record.drain_plateau_s, record.target_dmm / 10.0f, record.peak_dmm / 10.0f, record.error_dmm / 10.0f,
+               record.flags, record.curve_step_s, curve);
+    }
   }
 }
 
+// Helper function to set pump phase by number; status is published only
+// when the phase actually changes
+void set_pump_phase(int pump_num, PumpPhase phase) {
+  FLOOD_TIMED(TIMING_PHASE);
+  if (!bins.contains(pump_num)) return;
+  PumpPhase previous = pump_states.set(pump_num, phase);
+  if (previous == phase) return;
+  record_cycle_phase(pump_num, previous, phase, millis() - phase_started_ms[pump_num - 1]);
+  phase_started_ms[pump_num - 1] = millis();
+  if (phase == PumpPhase::FILLING) {
+    begin_fill(pump_num);
+    note_schedule_change();
+  }
+  if (phase == PumpPhase::DRAINING) drain_plateaus[pump_num - 1].reset();
+  // The calibrator only sees a dry tray between a depth-ended drain and the
+  // next cycle, and never changes the empty distance while one runs
+  if (phase != PumpPhase::IDLE) empty_calibrators[pump_num - 1].wet();
+  if (phase == PumpPhase::IDLE) {
+    wake_shelf_scheduler();
+  }
+  apply_depth_sample_rate(pump_num, phase);
+  publish_pump_status(pump_num);
+  if (aggregated_shelf_state.set_phase(pump_num, phase)) note_shelf_state_change();
+}
+
+// Flood cycle of every bin
+static FloodCycle flood_cycles[FLOOD_BIN_COUNT];
+
+// Length of a step of a bin's cycle, or its timeout if the bin ends it on depth
+int32_t get_cycle_step_ms(int bin_num, uint8_t step) {
+  const CycleStep &cycle_step = FLOOD_CYCLE_STEPS[step];
+  return (int32_t)(bins.get(bin_num, cycle_step.minutes, cycle_step.default_minutes) * 60000);
+}
+
+void cycle_step_timer(int bin_num) {
+  end_cycle_step(bin_num);
+}
+
+// Switch a bin's pump and phase to the step its cycle is now in, in the
+// order the old per-bin scripts did: the pump stops before the phase leaves
+// a pumping step, and the direction is set before it starts again. The step
+// lasts its full length, or resume_s when picked up after a reset.
+void enter_cycle_step(int bin_num, PumpPhase leaving, uint32_t resume_s = 0, uint8_t resumes = 0) {
+  if (!bins.contains(bin_num)) return;
+  PumpOutputBatch batch;
+  const BinRefs &bin = bins[bin_num];
+  const FloodCycle &cycle = flood_cycles[bin_num - 1];
+  PumpPhase phase = cycle.phase();
+  bool pumping = phase == PumpPhase::FILLING || phase == PumpPhase::DRAINING;
+  uint32_t step_s = 0;
+  if (cycle.running()) {
+    int32_t step_ms = get_cycle_step_ms(bin_num, cycle.step());
+    step_s = resume_s > 0 ? resume_s : step_ms > 1000 ? (step_ms + 999) / 1000 : 1;
+  }
+  // Checkpoint before the pump moves, so a reset its start causes finds it
+  cycle_checkpoint.save(bin_num, cycle.step(), flood_timers.now() + step_s, resumes);
+
+  if (!pumping) {
+    if (bin.set_pump != nullptr) bin.set_pump(false);
+    if (!cycle.running() && bin.set_reverse != nullptr) bin.set_reverse(false);
+  }
+  if (leaving == PumpPhase::FILLING && bin.fill_end == CycleEnd::DEPTH) record_fill_stop(bin_num);
+  set_pump_phase(bin_num, phase);
+  ESP_LOGI("cycle", "Bin %d: %s", bin_num, pump_phase_text(phase));
+  if (pumping) {
+    if (bin.set_reverse != nullptr) bin.set_reverse(phase == PumpPhase::FILLING);
+    if (bin.set_pump != nullptr) bin.set_pump(true);
+  }
+
+  size_t timer = TIMER_CYCLE + bin_num - 1;
+  if (!cycle.running()) {
+    flood_timers.cancel(timer);
+    return;
+  }
+  arm_flood_timer(timer, step_s, cycle_step_timer, bin_num);
+}
+
+// End the step a bin's cycle is in: its time is up, or its depth check is met
+void end_cycle_step(int bin_num) {
+  if (!bins.contains(bin_num) || !flood_cycles[bin_num - 1].running()) return;
+  PumpPhase leaving = flood_cycles[bin_num - 1].phase();
+  flood_cycles[bin_num - 1].advance();
+  enter_cycle_step(bin_num, leaving);
+}
+
+// A step resumed this often after resets is the likely cause of them (a
+// pump start that browns out the supply), so it isn't tried again
+static const uint8_t CYCLE_MAX_RESUMES = 2;
+
+// Call from on_boot before the schedules start: resume every cycle a reset
+// interrupted, with the time its step had left. A fill or soak that keeps
+// failing skips to the drain so the tray isn't left full; a drain that keeps
+// failing stops the bin in Fault until a cycle is started by hand.
+void resume_flood_cycles() {
+  CycleCheckpoint<FLOOD_BIN_COUNT>::Saved saved[FLOOD_BIN_COUNT];
+  bool valid = cycle_checkpoint.restore(saved);
+  cycle_checkpoint.reset();
+  if (!valid) {
+    ESP_LOGI("cycle", "No cycle checkpoint, starting idle");
+    return;
+  }
+  for (int bin_num = 1; bin_num <= bins.size(); bin_num++) {
+    CycleCheckpoint<FLOOD_BIN_COUNT>::Saved &bin = saved[bin_num - 1];
+    if (bin.step >= FLOOD_CYCLE_STEP_COUNT) continue;
+    const char *step_text = pump_phase_text(FLOOD_CYCLE_STEPS[bin.step].phase);
+    if (bin.resumes < CYCLE_MAX_RESUMES) {
+      ESP_LOGI("cycle", "Bin %d: resuming %s with %u s left", bin_num, step_text, (unsigned) bin.remaining_s);
+      flood_cycles[bin_num - 1].resume(bin.step);
+      enter_cycle_step(bin_num, PumpPhase::IDLE, bin.remaining_s > 0 ? bin.remaining_s : 1, bin.resumes + 1);
+    } else if (bin.step != CYCLE_DRAIN) {
+      ESP_LOGW("cycle", "Bin %d: %s interrupted by %u resets, draining", bin_num, step_text, (unsigned) bin.resumes + 1);
+      flood_cycles[bin_num - 1].resume(CYCLE_DRAIN);
+      enter_cycle_step(bin_num, PumpPhase::IDLE);
+    } else {
+      ESP_LOGE("cycle", "Bin %d: drain interrupted by %u resets, stopping", bin_num, (unsigned) bin.resumes + 1);
+      set_pump_phase(bin_num, PumpPhase::FAULT);
+    }
+  }
+}
+
+// Per-bin publish counters as "1:12/86388 2:8/86392", published/avoided: the
+// status used to be polled and published every second, so each second since
+// boot without a publish is one the phase-change publishing saved. Returns a
+// static buffer, overwritten by the next call.
+const char *format_publish_stats() {
+  static char out[FLOOD_BIN_COUNT * 24 + 1];
+  size_t length = 0;
+  out[0] = '\0';
+  for (int pump_num = 1; pump_num <= bins.size() && length < sizeof(out); pump_num++) {
+    uint32_t published = status_publishes[pump_num - 1];
+    uint32_t polls = flood_timers.now();
+    length += snprintf(out + length, sizeof(out) - length, "%s%d:%u/%u", length ? " " : "", pump_num,
+                       (unsigned) published, (unsigned) (polls > published ? polls - published : 0));
+  }
+  return out;
+}
+
 // Helper function to get bin enable state by number
 bool get_bin_enable(int bin_num) {
-  switch(bin_num) {
-    case 1: return id(bin_1_enable).state;
-    case 2: return id(bin_2_enable).state;
-    case 3: return id(bin_3_enable).state;
-    case 4: return id(bin_4_enable).state;
-    default: return false;
-  }
+  return bins.get(bin_num, &BinRefs::enable, false);
 }
 
 // Helper function to get next cycle timestamp by number
 int get_next_cycle_time(int bin_num) {
-  switch(bin_num) {
-    case 1: return id(bin_1_next_cycle);
-    case 2: return id(bin_2_next_cycle);
-    case 3: return id(bin_3_next_cycle);
-    case 4: return id(bin_4_next_cycle);
-    default: return 0;
-  }
+  return bins.get(bin_num, &BinRefs::next_cycle, 0);
 }
 
 // Forward declaration
@@ -89,323 +723,672 @@ float get_cycle_interval(int pump_num);
 void set_next_cycle_time(int bin_num, int current_time) {
   float interval_days = get_cycle_interval(bin_num);
   int interval_seconds = (int)(interval_days * 86400);
-  int next_time = current_time + interval_seconds;
-  
-  switch(bin_num) {
-    case 1: id(bin_1_next_cycle) = next_time; break;
-    case 2: id(bin_2_next_cycle) = next_time; break;
-    case 3: id(bin_3_next_cycle) = next_time; break;
-    case 4: id(bin_4_next_cycle) = next_time; break;
-  }
+  bins.set(bin_num, &BinRefs::next_cycle, current_time + interval_seconds);
 }
 
 // Helper function to get last cycle by number
 int get_last_cycle(int pump_num) {
-  switch(pump_num) {
-    case 1: return id(pump_1_last_cycle);
-    case 2: return id(pump_2_last_cycle);
-    case 3: return id(pump_3_last_cycle);
-    case 4: return id(pump_4_last_cycle);
-    default: return 0;
-  }
+  return bins.get(pump_num, &BinRefs::last_cycle, 0);
 }
 
 // Helper function to get cycle interval by number
 float get_cycle_interval(int pump_num) {
-  switch(pump_num) {
-    case 1: return id(pump_1_cycle_interval).state;
-    case 2: return id(pump_2_cycle_interval).state;
-    case 3: return id(pump_3_cycle_interval).state;
-    case 4: return id(pump_4_cycle_interval).state;
-    default: return 1.0;
-  }
+  return bins.get(pump_num, &BinRefs::cycle_interval, 1.0f);
 }
 
 // Helper function to get schedule mode by number (0 = interval days, 1 = daily times)
 int get_schedule_mode(int bin_num) {
-  switch(bin_num) {
-    case 1: return id(bin_1_schedule_mode);
-    case 2: return id(bin_2_schedule_mode);
-    case 3: return id(bin_3_schedule_mode);
-    case 4: return id(bin_4_schedule_mode);
-    default: return 0;
-  }
+  return bins.get(bin_num, &BinRefs::schedule_mode, 0);
+}
+
+// Helper function to get daily times by number; a reference to the entity's
+// state, so reading it doesn't copy
+const char *get_daily_times(int bin_num) {
+  if (!bins.contains(bin_num) || bins[bin_num].daily_times == nullptr) return "10";
+  return bins[bin_num].daily_times().c_str();
 }
 
-// Helper function to get daily times by number
-std::string get_daily_times(int bin_num) {
-  switch(bin_num) {
-    case 1: return id(ha_bin_1_daily_times).state;
-    case 2: return id(ha_bin_2_daily_times).state;
-    case 3: return id(ha_bin_3_daily_times).state;
-    case 4: return id(ha_bin_4_daily_times).state;
-    default: return "10";
+// Compiled daily times per bin, rebuilt only when the input_text changes
+static CompiledSchedule daily_schedules[FLOOD_BIN_COUNT];
+
+// Recompile a bin's daily times; call from the input_text's on_value.
+// Malformed input is rejected and the previous schedule is kept.
+bool update_daily_times(int bin_num, const std::string &daily_times) {
+  if (!bins.contains(bin_num)) return false;
+  if (!compile_daily_times(daily_times.c_str(), daily_times.size(), daily_schedules[bin_num - 1])) {
+    ESP_LOGW("schedule", "Bin %d: ignoring malformed daily times '%s'", bin_num, daily_times.c_str());
+    return false;
   }
+  return true;
+}
+
+// Helper function to get the compiled daily times by number
+const CompiledSchedule &get_daily_schedule(int bin_num) {
+  static const CompiledSchedule empty;
+  return bins.contains(bin_num) ? daily_schedules[bin_num - 1] : empty;
 }
 
 // Helper function to get interval time by number
 int get_interval_time(int bin_num) {
-  switch(bin_num) {
-    case 1: return id(bin_1_interval_time);
-    case 2: return id(bin_2_interval_time);
-    case 3: return id(bin_3_interval_time);
-    case 4: return id(bin_4_interval_time);
-    default: return 10;
-  }
+  return bins.get(bin_num, &BinRefs::interval_time, 10);
 }
 
-// Helper function to check if all pumps are idle
+// No cycle running on any bin; a bin in Fault counts, as nothing runs on it
+// until someone clears it
 bool are_all_pumps_idle() {
-  return (get_pump_state(1) == "Idle" && 
-          get_pump_state(2) == "Idle" && 
-          get_pump_state(3) == "Idle" && 
-          get_pump_state(4) == "Idle");
+  return !pump_states.any_cycling();
 }
 
 // Helper function to get queue pending state by number
 bool get_queue_pending(int bin_num) {
-  switch(bin_num) {
-    case 1: return id(queue_pending_1);
-    case 2: return id(queue_pending_2);
-    case 3: return id(queue_pending_3);
-    case 4: return id(queue_pending_4);
-    default: return false;
-  }
+  return bins.get(bin_num, &BinRefs::queue_pending, false);
 }
 
 // Helper function to set queue pending state by number
 void set_queue_pending(int bin_num, bool value) {
-  switch(bin_num) {
-    case 1: id(queue_pending_1) = value; break;
-    case 2: id(queue_pending_2) = value; break;
-    case 3: id(queue_pending_3) = value; break;
-    case 4: id(queue_pending_4) = value; break;
-  }
+  bins.set(bin_num, &BinRefs::queue_pending, value);
 }
 
 // Helper function to set last cycle by number
 void set_last_cycle(int pump_num, int value) {
-  switch(pump_num) {
-    case 1: id(pump_1_last_cycle) = value; break;
-    case 2: id(pump_2_last_cycle) = value; break;
-    case 3: id(pump_3_last_cycle) = value; break;
-    case 4: id(pump_4_last_cycle) = value; break;
-  }
+  bins.set(pump_num, &BinRefs::last_cycle, value);
 }
 
-// Helper function to execute flood cycle by number
+// Helper function to start a bin's flood cycle by number; a start while the
+// cycle is running is ignored
 void execute_flood_cycle(int pump_num) {
-  switch(pump_num) {
-    case 1: id(pump_1_flood_cycle).execute(); break;
-    case 2: id(pump_2_flood_cycle).execute(); break;
-    case 3: id(pump_3_flood_cycle).execute(); break;
-    case 4: id(pump_4_flood_cycle).execute(); break;
+  if (!bins.contains(pump_num)) return;
+  if (!flood_cycles[pump_num - 1].start()) {
+    ESP_LOGW("cycle", "Bin %d: start ignored, cycle already %s", pump_num, pump_phase_text(get_pump_phase(pump_num)));
+    return;
   }
+  enter_cycle_step(pump_num, PumpPhase::IDLE);
 }
 
-// Simplified countdown calculation for display only
-float calculate_countdown_hours(int pump_num) {
-  bool bin_enable = get_bin_enable(pump_num);
-  
-  if (!bin_enable) {
-    return NAN;
+// Days since a bin last ran in interval mode (-1 if it has never run)
+int get_days_since_last_run(int bin_num, const ESPTime &now) {
+  int last_run_day = bins.get(bin_num, &BinRefs::last_run_day, 0);
+  if (last_run_day <= 0) return -1;
+  if (now.day_of_year >= last_run_day) return now.day_of_year - last_run_day;
+  // Ran last year, which had 366 days if it was a leap year
+  int year = now.year - 1;
+  int days_last_year = (year % 4 == 0 && (year % 100 != 0 || year % 400 == 0)) ? 366 : 365;
+  return now.day_of_year + days_last_year - last_run_day;
+}
+
+// Scheduling state of every bin, as journalled to flash
+struct ScheduleRecord {
+  int32_t last_cycle[FLOOD_BIN_COUNT];
+  int32_t next_cycle[FLOOD_BIN_COUNT];
+  int16_t last_run_day[FLOOD_BIN_COUNT];
+};
+
+// Journal ring, keyed by bin count so a different table never replays it
+static const size_t SCHEDULE_JOURNAL_SLOTS = 8;
+static FlashJournal<ScheduleRecord, SCHEDULE_JOURNAL_SLOTS> schedule_journal(0x464C4A00 + FLOOD_BIN_COUNT * 16);
+
+// Changes within this long of the last append are batched into the next one
+static const uint32_t SCHEDULE_JOURNAL_BATCH_MS = 30 * 60 * 1000;
+
+static ScheduleRecord schedule_journalled;
+static uint32_t schedule_journalled_ms = 0;
+
+// Scheduling state of every bin right now
+ScheduleRecord snapshot_schedule() {
+  ScheduleRecord record;
+  memset(&record, 0, sizeof(record));
+  for (int bin_num = 1; bin_num <= bins.size(); bin_num++) {
+    record.last_cycle[bin_num - 1] = bins.get(bin_num, &BinRefs::last_cycle, 0);
+    record.next_cycle[bin_num - 1] = bins.get(bin_num, &BinRefs::next_cycle, 0);
+    record.last_run_day[bin_num - 1] = bins.get(bin_num, &BinRefs::last_run_day, 0);
   }
-  
-  auto now = id(homeassistant_time).now();
-  auto current_time = now.timestamp;
-  int next_cycle_time = get_next_cycle_time(pump_num);
-  
-  if (next_cycle_time == 0) {
-    int current_hour = now.hour;
-    int current_minute = now.minute;
-    int current_day = now.day_of_year;
-    int schedule_mode = get_schedule_mode(pump_num);
-    
-    if (schedule_mode == 0) {
-      int last_run_day = 0;
-      switch(pump_num) {
-        case 1: last_run_day = id(bin_1_last_run_day); break;
-        case 2: last_run_day = id(bin_2_last_run_day); break;
-        case 3: last_run_day = id(bin_3_last_run_day); break;
-        case 4: last_run_day = id(bin_4_last_run_day); break;
-      }
-      
-      int days_since = 0;
-      if (last_run_day > 0) {
-        days_since = (current_day - last_run_day + 365) % 365;
-      }
-      
-      float interval_days = get_cycle_interval(pump_num);
-      int interval_time = get_interval_time(pump_num);
-      
-      int hours_until = interval_time - current_hour;
-      if (hours_until <= 0) hours_until += 24;
-      
-      if (days_since >= (int)interval_days) {
-        return hours_until;
-      } else {
-        int days_until = (int)interval_days - days_since;
-        return (days_until * 24) + hours_until;
-      }
-    } else {
-      // Daily Times mode
-      std::string daily_times = get_daily_times(pump_num);
-      
-      std::stringstream ss(daily_times);
-      std::string time_str;
-      std::vector<int> times;
-      while (std::getline(ss, time_str, ',')) {
-        time_str.erase(0, time_str.find_first_not_of(" \t"));
-        time_str.erase(time_str.find_last_not_of(" \t") + 1);
-        if (!time_str.empty()) {
-          times.push_back(std::stoi(time_str));
-        }
-      }
-      
-      std::sort(times.begin(), times.end());
-      
-      for (int time : times) {
-        if (time > current_hour) {
-          int total_minutes = (time * 60) - (current_hour * 60 + current_minute);
-          return total_minutes / 60.0;
-        }
+  return record;
+}
+
+// Call from on_boot: replay the journal into the scheduling globals
+void restore_schedule_journal() {
+  ScheduleRecord record;
+  if (!schedule_journal.restore(record)) {
+    ESP_LOGI("journal", "No schedule journal, starting fresh");
+    schedule_journalled = snapshot_schedule();
+    return;
+  }
+  for (int bin_num = 1; bin_num <= bins.size(); bin_num++) {
+    bins.set(bin_num, &BinRefs::last_cycle, (int) record.last_cycle[bin_num - 1]);
+    bins.set(bin_num, &BinRefs::next_cycle, (int) record.next_cycle[bin_num - 1]);
+    bins.set(bin_num, &BinRefs::last_run_day, (int) record.last_run_day[bin_num - 1]);
+  }
+  schedule_journalled = record;
+  ESP_LOGI("journal", "Restored schedule state of %d bins", bins.size());
+}
+
+// Append the scheduling state if it changed, at most once per batch period,
+// so a watering round's starts cost one or two writes. Returns the ms left
+// until the batch period allows a pending change to be written, else 0.
+uint32_t service_schedule_journal() {
+  FLOOD_TIMED(TIMING_JOURNAL);
+  ScheduleRecord record = snapshot_schedule();
+  if (memcmp(&record, &schedule_journalled, sizeof(record)) == 0) return 0;
+  uint32_t since = millis() - schedule_journalled_ms;
+  if (schedule_journal.writes() > 0 && since < SCHEDULE_JOURNAL_BATCH_MS) return SCHEDULE_JOURNAL_BATCH_MS - since;
+  if (!schedule_journal.append(record)) {
+    ESP_LOGW("journal", "Schedule journal write failed");
+    return 0;
+  }
+  schedule_journalled = record;
+  schedule_journalled_ms = millis();
+  return 0;
+}
+
+// Journal timer: write now, or come back when the batch period is up
+void journal_timer(int) {
+  uint32_t wait_ms = service_schedule_journal();
+  if (wait_ms > 0) {
+    arm_flood_timer(TIMER_JOURNAL, (wait_ms + 999) / 1000, journal_timer, 0);
+  }
+}
+
+// One stretch of a cycle with its pump running, in ms relative to now
+struct PumpWindow {
+  int32_t start;
+  int32_t end;
+  float amps;
+};
+
+// Slack after each pump window for cycle timing jitter
+static const int32_t PUMP_WINDOW_GUARD_MS = 5000;
+
+// Pump windows left in a bin's timed cycle, given its phase and how long it
+// has been in it, for a pump drawing rated_amps at 100%. Returns the count.
+int get_pump_windows(int bin_num, PumpPhase phase, int32_t elapsed_ms, float rated_amps, PumpWindow out[2]) {
+  int32_t fill_ms = get_cycle_step_ms(bin_num, CYCLE_FILL);
+  int32_t soak_ms = get_cycle_step_ms(bin_num, CYCLE_SOAK);
+  int32_t drain_ms = get_cycle_step_ms(bin_num, CYCLE_DRAIN);
+  // At the level the pump really runs each step: the fill runs it in
+  // reverse (enter_cycle_step()), so at the drain speed, and the drain forward
+  float fill_amps = rated_amps * get_pump_level(bin_num, true);
+  float drain_amps = rated_amps * get_pump_level(bin_num, false);
+
+  // Start of the drain relative to the start of the current phase
+  int32_t drain_start;
+  int count = 0;
+  switch (phase) {
+    case PumpPhase::FILLING:
+      out[count++] = {-elapsed_ms, fill_ms - elapsed_ms + PUMP_WINDOW_GUARD_MS, fill_amps};
+      drain_start = fill_ms + soak_ms;
+      break;
+    case PumpPhase::SOAKING:
+      drain_start = soak_ms;
+      break;
+    case PumpPhase::DRAINING:
+      drain_start = 0;
+      break;
+    default:
+      return 0;
+  }
+  out[count++] = {drain_start - elapsed_ms, drain_start + drain_ms - elapsed_ms + PUMP_WINDOW_GUARD_MS, drain_amps};
+  return count;
+}
+
+// True if a cycle's pump windows fit in the budget alongside the running ones:
+// draw only rises where a window starts, so checking the sum at every window
+// start inside the candidate's windows covers its whole run
+bool pump_windows_fit(const PumpWindow *candidate, int candidate_count, const PumpWindow *running,
+                      int running_count, float budget_amps) {
+  for (int c = 0; c < candidate_count; c++) {
+    for (int p = -1; p < running_count; p++) {
+      int32_t at = p < 0 ? candidate[c].start : running[p].start;
+      if (at < candidate[c].start || at >= candidate[c].end) continue;
+      float amps = 0;
+      for (int i = 0; i < candidate_count; i++) {
+        if (candidate[i].start <= at && at < candidate[i].end) amps += candidate[i].amps;
       }
-      
-      if (!times.empty()) {
-        int total_minutes = (24 * 60) - (current_hour * 60 + current_minute) + (times[0] * 60);
-        return total_minutes / 60.0;
-      } else {
-        return 24.0;
+      for (int i = 0; i < running_count; i++) {
+        if (running[i].start <= at && at < running[i].end) amps += running[i].amps;
       }
+      if (amps > budget_amps + 0.001f) return false;
     }
   }
-  
-  if (next_cycle_time > current_time) {
-    auto time_diff = next_cycle_time - current_time;
-    return time_diff / 3600.0;
+  return true;
+}
+
+// Watering-window bookkeeping of the shelf scheduler
+static time_t watering_window_start = 0;
+static bool watering_window_done = true;
+static bool watering_pending[FLOOD_BIN_COUNT];
+static bool fault_missed[FLOOD_BIN_COUNT];  // a due bin in Fault, counted missed once
+static int last_makespan_minutes = 0;
+static int missed_watering_windows = 0;
+
+// Minutes from the last watering window opening to its last cycle finishing
+int get_last_makespan_minutes() {
+  return last_makespan_minutes;
+}
+
+// Windows in which a due bin couldn't start before the next window opened
+int get_missed_watering_windows() {
+  return missed_watering_windows;
+}
+
+// Open today's watering window: bins still queued from the last one have
+// slipped a day, and every enabled bin whose interval has passed is queued.
+// A bin in Fault can't start until someone clears it, so it isn't queued;
+// the first window it is due in counts as missed.
+void open_watering_window(time_t window_start) {
+  watering_window_start = window_start;
+  watering_window_done = false;
+  for (int bin_num = 1; bin_num <= bins.size(); bin_num++) {
+    bool &pending = watering_pending[bin_num - 1];
+    if (pending) {
+      missed_watering_windows++;
+      ESP_LOGW("schedule", "Bin %d: missed a watering window", bin_num);
+    }
+    // Due if it last ran before the window interval-1 days ago, so a cycle
+    // that started late in the day doesn't push the next one back a day
+    int interval_days = (int) get_cycle_interval(bin_num);
+    time_t due_before = window_start - (time_t)(interval_days > 1 ? interval_days - 1 : 0) * 86400;
+    pending = get_bin_enable(bin_num) && get_last_cycle(bin_num) < due_before;
+    if (get_pump_phase(bin_num) != PumpPhase::FAULT) {
+      fault_missed[bin_num - 1] = false;
+    } else if (pending) {
+      pending = false;
+      if (!fault_missed[bin_num - 1]) {
+        fault_missed[bin_num - 1] = true;
+        missed_watering_windows++;
+        ESP_LOGW("schedule", "Bin %d: in Fault, not watering until it is cleared", bin_num);
+      }
+    }
   }
-  
-  return 0.0;
 }
 
-// Simplified countdown text calculation for display only
-std::string calculate_countdown_text(int pump_num) {
-  bool bin_enable = get_bin_enable(pump_num);
+// Round-robin position of the shelf scheduler
+static int current_pump_sequence = 1;
+
+// Power-budgeted, phase-pipelined scheduler, run by shelf_scheduler_timer(). Bins become
+// due when the watering hour opens and stay queued until they start, past the
+// end of the hour if need be. Each start is admitted only if its fill and
+// drain windows, laid over the pump windows of the cycles already running,
+// never take the total draw over the supply budget - so one bin's soak can
+// overlap another's fill or drain. A budget that fits one pump keeps one pump
+// moving at a time.
+void run_budgeted_scheduler(int watering_hour, float budget_amps, float rated_amps) {
+  FLOOD_TIMED(TIMING_SCHEDULER);
+  PumpOutputBatch batch;  // pumps admitted together cost one bus write per driver board
+  auto now = shelf_now();
+  if (!now.is_valid()) {
+    return;
+  }
+  auto current_time = now.timestamp;
   
-  if (!bin_enable) {
-    return "Disabled";
+  // Open the window once, at the configured hour (Home Assistant should handle timezone)
+  time_t window_start = current_time - now.minute * 60 - now.second;
+  if (now.hour == watering_hour && window_start != watering_window_start) {
+    open_watering_window(window_start);
   }
   
-  auto now = id(homeassistant_time).now();
-  auto current_time = now.timestamp;
-  int next_cycle_time = get_next_cycle_time(pump_num);
+  // Pump windows of every running cycle
+  PumpWindow running[2 * FLOOD_BIN_COUNT];
+  int running_count = 0;
+  bool any_pending = false;
+  for (int bin_num = 1; bin_num <= bins.size(); bin_num++) {
+    PumpPhase phase = get_pump_phase(bin_num);
+    int32_t elapsed = (int32_t)(millis() - phase_started_ms[bin_num - 1]);
+    running_count += get_pump_windows(bin_num, phase, elapsed, rated_amps, running + running_count);
+    any_pending = any_pending || watering_pending[bin_num - 1];
+  }
   
-  if (next_cycle_time == 0) {
-    int current_hour = now.hour;
-    int current_minute = now.minute;
-    int current_day = now.day_of_year;
-    int schedule_mode = get_schedule_mode(pump_num);
+  // Window finished: every queued bin started and every cycle done
+  if (!watering_window_done && !any_pending && running_count == 0) {
+    watering_window_done = true;
+    last_makespan_minutes = (int)((current_time - watering_window_start) / 60);
+    ESP_LOGI("schedule", "Watering window done in %d min", last_makespan_minutes);
+  }
+  if (!any_pending) {
+    return;
+  }
+  
+  int first = current_pump_sequence;
+  for (int attempts = 0; attempts < bins.size(); attempts++) {
+    int bin_num = (first - 1 + attempts) % bins.size() + 1;
+    bool &pending = watering_pending[bin_num - 1];
+    if (!pending) {
+      continue;
+    }
+    // Disabled or faulted while queued: drop it
+    if (!get_bin_enable(bin_num) || get_pump_phase(bin_num) == PumpPhase::FAULT) {
+      pending = false;
+      continue;
+    }
+    if (get_pump_phase(bin_num) != PumpPhase::IDLE) {
+      continue;
+    }
     
-    if (schedule_mode == 0) {
-      int last_run_day = 0;
-      switch(pump_num) {
-        case 1: last_run_day = id(bin_1_last_run_day); break;
-        case 2: last_run_day = id(bin_2_last_run_day); break;
-        case 3: last_run_day = id(bin_3_last_run_day); break;
-        case 4: last_run_day = id(bin_4_last_run_day); break;
-      }
-      
-      int days_since = 0;
-      if (last_run_day > 0) {
-        days_since = (current_day - last_run_day + 365) % 365;
-      }
-      
-      float interval_days = get_cycle_interval(pump_num);
-      int interval_time = get_interval_time(pump_num);
-      
-      int hours_until = interval_time - current_hour;
-      if (hours_until <= 0) hours_until += 24;
-      
-      if (days_since >= (int)interval_days) {
-        return std::to_string(hours_until) + "h";
-      } else {
-        int days_until = (int)interval_days - days_since;
-        if (days_until > 0) {
-          return std::to_string(days_until) + "d " + std::to_string(hours_until) + "h";
-        } else {
-          return std::to_string(hours_until) + "h";
-        }
-      }
-    } else {
-      // Daily Times mode
-      std::string daily_times = get_daily_times(pump_num);
-      
-      std::stringstream ss(daily_times);
-      std::string time_str;
-      std::vector<int> times;
-      while (std::getline(ss, time_str, ',')) {
-        time_str.erase(0, time_str.find_first_not_of(" \t"));
-        time_str.erase(time_str.find_last_not_of(" \t") + 1);
-        if (!time_str.empty()) {
-          times.push_back(std::stoi(time_str));
-        }
-      }
-      
-      std::sort(times.begin(), times.end());
-      
-      for (int time : times) {
-        if (time > current_hour) {
-          int total_minutes = (time * 60) - (current_hour * 60 + current_minute);
-          
-          if (total_minutes >= 60) {
-            int hours = total_minutes / 60;
-            int minutes = total_minutes % 60;
-            if (minutes > 0) {
-              return std::to_string(hours) + "h " + std::to_string(minutes) + "m";
-            } else {
-              return std::to_string(hours) + "h";
-            }
-          } else {
-            return std::to_string(total_minutes) + "m";
-          }
-        }
-      }
-      
-      if (!times.empty()) {
-        int total_minutes = (24 * 60) - (current_hour * 60 + current_minute) + (times[0] * 60);
-        
-        if (total_minutes >= 60) {
-          int hours = total_minutes / 60;
-          int minutes = total_minutes % 60;
-          if (minutes > 0) {
-            return std::to_string(hours) + "h " + std::to_string(minutes) + "m";
-          } else {
-            return std::to_string(hours) + "h";
-          }
-        } else {
-          return std::to_string(total_minutes) + "m";
-        }
-      } else {
-        return "No times configured";
-      }
+    PumpWindow candidate[2];
+    int candidate_count = get_pump_windows(bin_num, PumpPhase::FILLING, 0, rated_amps, candidate);
+    if (!pump_windows_fit(candidate, candidate_count, nullptr, 0, budget_amps)) {
+      ESP_LOGW("schedule", "Bin %d: pump draw is over the %.2f A budget", bin_num, budget_amps);
+      pending = false;
+      continue;
     }
+    // The next bin in line doesn't fit yet: wait rather than letting later
+    // bins jump the queue
+    if (!pump_windows_fit(candidate, candidate_count, running, running_count, budget_amps)) {
+      break;
+    }
+    
+    execute_flood_cycle(bin_num);
+    set_last_cycle(bin_num, current_time);
+    pending = false;
+    for (int i = 0; i < candidate_count; i++) running[running_count++] = candidate[i];
+    current_pump_sequence = bin_num % bins.size() + 1;
   }
+}
+
+// Per-bin scheduler for one bin: start it if it is enabled, idle and its
+// interval-days or daily-times schedule fires this minute
+void run_bin_schedule(int bin_num, const ESPTime &now) {
+  FLOOD_TIMED(TIMING_SCHEDULER);
+  if (!get_bin_enable(bin_num)) {
+    return;
+  }
+  auto current_time = now.timestamp;
+  bool should_run = false;
   
-  if (next_cycle_time <= current_time) {
-    return "Due now";
+  if (get_schedule_mode(bin_num) == 0) {
+    // Interval Days mode
+    int days_since = get_days_since_last_run(bin_num, now);
+    if (now.hour == get_interval_time(bin_num) && now.minute == 0 &&
+        (days_since < 0 || days_since >= (int)get_cycle_interval(bin_num))) {
+      should_run = true;
+      bins.set(bin_num, &BinRefs::last_run_day, (int)now.day_of_year);
+    }
+  } else {
+    // Daily Times mode (compiled when the input_text changes)
+    should_run = schedule_fires_at(get_daily_schedule(bin_num), now.hour, now.minute);
   }
   
-  auto time_diff = next_cycle_time - current_time;
-  int days = time_diff / 86400;
-  int hours = (time_diff % 86400) / 3600;
-  int minutes = ((time_diff % 86400) % 3600) / 60;
+  if (should_run && get_pump_phase(bin_num) == PumpPhase::IDLE) {
+    set_last_cycle(bin_num, current_time);
+    bins.set(bin_num, &BinRefs::next_cycle, (int)current_time);
+    execute_flood_cycle(bin_num);
+  }
+}
+
+// Minutes until a bin's next scheduled run, or -1 if no times are configured
+int get_minutes_until_scheduled(int bin_num, const ESPTime &now) {
+  if (get_schedule_mode(bin_num) == 0) {
+    return minutes_until_interval_fire((int)get_cycle_interval(bin_num), get_interval_time(bin_num),
+                                       get_days_since_last_run(bin_num, now), now.hour, now.minute);
+  }
+  return minutes_until_next_fire(get_daily_schedule(bin_num), now.hour, now.minute);
+}
+
+// Longest a schedule timer sleeps, so wall-clock corrections and settings
+// changed from Home Assistant take effect within the hour
+static const uint32_t SCHEDULE_TIMER_MAX_S = 3600;
+
+// Seconds from now until the start of the given minute offset, clamped to
+// 1..SCHEDULE_TIMER_MAX_S
+uint32_t schedule_timer_delay(int minutes_until, const ESPTime &now) {
+  if (minutes_until < 0) return SCHEDULE_TIMER_MAX_S;
+  int32_t delay_s = minutes_until * 60 - now.second;
+  if (delay_s < 1) return 1;
+  return delay_s > (int32_t) SCHEDULE_TIMER_MAX_S ? SCHEDULE_TIMER_MAX_S : delay_s;
+}
+
+// Shelf-wide settings of the budgeted scheduler
+int get_watering_hour() {
+  return (int) shelf.get(&ShelfRefs::watering_hour, 9);
+}
+float get_supply_budget() {
+  return shelf.get(&ShelfRefs::supply_budget, 1.0f);
+}
+float get_pump_rated_current() {
+  return shelf.get(&ShelfRefs::pump_rated_current, 1.0f);
+}
+
+// True while bins of the current watering window are still queued
+bool is_watering_queued() {
+  for (int bin_num = 1; bin_num <= bins.size(); bin_num++) {
+    if (watering_pending[bin_num - 1]) return true;
+  }
+  return false;
+}
+
+// Set once the budgeted scheduler runs the shelf, instead of per-bin schedules
+static bool shelf_scheduler_started = false;
+
+// Unix time of a bin's next scheduled start, 0 while it is due and queued,
+// or ShelfState's NONE if it is disabled or has nothing planned
+int32_t get_next_fire_time(int bin_num, const ESPTime &now) {
+  if (!get_bin_enable(bin_num)) return ShelfState<FLOOD_BIN_COUNT>::NONE;
+  time_t minute_start = now.timestamp - now.second;
+  if (shelf_scheduler_started) {
+    if (watering_pending[bin_num - 1]) return 0;
+    // The first watering window in which open_watering_window() finds the
+    // bin due
+    int now_minutes = now.hour * 60 + now.minute;
+    int minutes_until = (get_watering_hour() * 60 - now_minutes + MINUTES_PER_DAY) % MINUTES_PER_DAY;
+    time_t window = minute_start + (time_t)(minutes_until == 0 ? MINUTES_PER_DAY : minutes_until) * 60;
+    int interval_days = (int) get_cycle_interval(bin_num);
+    time_t due_after = get_last_cycle(bin_num) + (time_t)(interval_days > 1 ? interval_days - 1 : 0) * 86400;
+    if (window <= due_after) window += ((due_after - window) / 86400 + 1) * 86400;
+    return (int32_t) window;
+  }
+  int next_cycle_time = get_next_cycle_time(bin_num);
+  if (next_cycle_time > now.timestamp) return next_cycle_time;
+  int minutes_until = get_minutes_until_scheduled(bin_num, now);
+  if (minutes_until < 0) return ShelfState<FLOOD_BIN_COUNT>::NONE;
+  return (int32_t)(minute_start + (time_t) minutes_until * 60);
+}
+
+// Longest an idle shelf sleeps between ticks
+static const uint32_t IDLE_SLEEP_MAX_S = 3600;
+
+// Seconds until the next thing an idle shelf has to do: a schedule firing
+// (the watering hour on a shelf with the budgeted scheduler) or a timer
+uint32_t get_next_wake_s(const ESPTime &now) {
+  BinSchedule schedules[FLOOD_BIN_COUNT];
+  size_t count = 0;
+  if (shelf_scheduler_started) {
+    schedules[count++] = {true, false, nullptr, 1, get_watering_hour(), -1};
+  } else {
+    for (int bin_num = 1; bin_num <= bins.size(); bin_num++) {
+      schedules[count++] = {get_bin_enable(bin_num), get_schedule_mode(bin_num) != 0, &get_daily_schedule(bin_num),
+                            (int) get_cycle_interval(bin_num), get_interval_time(bin_num),
+                            get_days_since_last_run(bin_num, now)};
+    }
+  }
+  return next_wake_s(minutes_until_any_fire(schedules, count, now.hour, now.minute), now.second,
+                     flood_timers.next_due(), IDLE_SLEEP_MAX_S);
+}
+
+// Low-power idle: while it is on, no cycle runs and no bin is queued, tick
+// the wheel only when the next schedule or timer is due
+void update_idle_tick() {
+  uint32_t ms = FLOOD_TICK_MS;
+  if (shelf.low_power_idle() && are_all_pumps_idle() && !is_watering_queued()) {
+    auto now = shelf_now();
+    if (now.is_valid()) ms = get_next_wake_s(now) * 1000;
+  }
+  set_flood_tick_ms(ms);
+}
+
+// Bring every bin's next start in the shelf state up to date
+void refresh_shelf_schedule(const ESPTime &now) {
+  bool changed = false;
+  for (int bin_num = 1; bin_num <= bins.size(); bin_num++) {
+    changed = aggregated_shelf_state.set_next_fire(bin_num, get_next_fire_time(bin_num, now)) || changed;
+  }
+  if (changed) note_shelf_state_change();
+}
+
+// Shelf scheduler timer: run the scheduler, then sleep until the next minute
+// while bins are queued, else until the watering hour opens
+void shelf_scheduler_timer(int) {
+  auto now = shelf_now();
+  if (!now.is_valid()) {
+    arm_flood_timer(TIMER_SCHEDULER, 10, shelf_scheduler_timer, 0);
+    return;
+  }
+  int watering_hour = get_watering_hour();
+  run_budgeted_scheduler(watering_hour, get_supply_budget(), get_pump_rated_current());
+  refresh_shelf_schedule(now);
   
+  int minutes_until;
+  if (is_watering_queued()) {
+    minutes_until = 1;
+  } else {
+    int now_minutes = now.hour * 60 + now.minute;
+    minutes_until = (watering_hour * 60 - now_minutes + MINUTES_PER_DAY) % MINUTES_PER_DAY;
+    if (minutes_until == 0) minutes_until = MINUTES_PER_DAY;
+  }
+  arm_flood_timer(TIMER_SCHEDULER, schedule_timer_delay(minutes_until, now), shelf_scheduler_timer, 0);
+}
+
+// Per-bin schedule timer: check the bin, then sleep until its next fire
+void bin_schedule_timer(int bin_num) {
+  size_t timer = TIMER_BIN_SCHEDULE + bin_num - 1;
+  auto now = shelf_now();
+  if (!now.is_valid()) {
+    arm_flood_timer(timer, 10, bin_schedule_timer, bin_num);
+    return;
+  }
+  run_bin_schedule(bin_num, now);
+  refresh_shelf_schedule(now);
+  arm_flood_timer(timer, schedule_timer_delay(get_minutes_until_scheduled(bin_num, now), now), bin_schedule_timer,
+                   bin_num);
+}
+
+// Re-plan a bin's schedule timer after its schedule settings change
+void reschedule_bin(int bin_num) {
+  if (bins.contains(bin_num) && flood_timers.armed(TIMER_BIN_SCHEDULE + bin_num - 1)) {
+    arm_flood_timer(TIMER_BIN_SCHEDULE + bin_num - 1, 1, bin_schedule_timer, bin_num);
+  }
+}
+
+// Call from the SNTP time's on_time_sync. The shelf clock takes SNTP even
+// behind the latest journalled cycle start, since that start can only be
+// ahead of it if a wrong time once reached the journal; such starts are
+// pulled back to now so the schedules run again.
+void on_trusted_time_sync() {
+  auto sntp = id(sntp_time).now();
+  if (!sntp.is_valid()) return;
+  int32_t step = shelf_clock.trust(sntp.timestamp, millis());
+  ESP_LOGI("clock", "SNTP synced, %+ld s", (long) step);
+  bool pulled_back = false;
+  for (int bin_num = 1; bin_num <= bins.size(); bin_num++) {
+    if (get_last_cycle(bin_num) <= sntp.timestamp) continue;
+    ESP_LOGW("clock", "Bin %d: last cycle start %ld s ahead of SNTP, moved back to now", bin_num,
+             (long) (get_last_cycle(bin_num) - sntp.timestamp));
+    set_last_cycle(bin_num, (int) sntp.timestamp);
+    reschedule_bin(bin_num);
+    pulled_back = true;
+  }
+  if (pulled_back) {
+    note_schedule_change();
+    wake_shelf_scheduler();
+  }
+}
+
+// Countdown timer: refresh every bin's countdown sensor each minute, and
+// pick up schedule settings changed from Home Assistant in the shelf state
+void countdown_timer(int) {
+  for (int bin_num = 1; bin_num <= bins.size(); bin_num++) {
+    if (bins[bin_num].update_countdown != nullptr) bins[bin_num].update_countdown();
+  }
+  auto now = shelf_now();
+  if (now.is_valid()) refresh_shelf_schedule(now);
+  // In low-power idle the countdowns refresh hourly; the shelf state's next
+  // starts are absolute and stay exact
+  uint32_t delay_s = now.is_valid() ? 60 - now.second : 60;
+  if (shelf.low_power_idle()) delay_s = SCHEDULE_TIMER_MAX_S;
+  arm_flood_timer(TIMER_COUNTDOWN, delay_s, countdown_timer, 0);
+}
+
+// Call from the low-power idle switch's on_state: refresh the countdowns
+// and re-plan the tick on the next second
+void on_low_power_change() {
+  arm_flood_timer(TIMER_COUNTDOWN, 1, countdown_timer, 0);
+}
+
+// Call from on_boot on a shelf using the budgeted scheduler
+void start_shelf_scheduler() {
+  flood_timers_ms = millis();
+  shelf_scheduler_started = true;
+  publish_shelf_state();
+  arm_flood_timer(TIMER_SCHEDULER, 1, shelf_scheduler_timer, 0);
+  arm_flood_timer(TIMER_COUNTDOWN, 1, countdown_timer, 0);
+}
+
+// Call from on_boot on a shelf using per-bin schedules
+void start_bin_schedules() {
+  flood_timers_ms = millis();
+  publish_shelf_state();
+  for (int bin_num = 1; bin_num <= bins.size(); bin_num++) {
+    arm_flood_timer(TIMER_BIN_SCHEDULE + bin_num - 1, 1, bin_schedule_timer, bin_num);
+  }
+  arm_flood_timer(TIMER_COUNTDOWN, 1, countdown_timer, 0);
+}
+
+// Countdown texts are formatted into this buffer, so a countdown sensor's
+// update doesn't allocate; each call overwrites the previous text
+static char countdown_text[24];
+
+// Format a countdown in minutes as "2d 4h", "3h 15m", "3h" or "45m"
+const char *format_countdown_minutes(int total_minutes) {
+  int days = total_minutes / MINUTES_PER_DAY;
+  int hours = (total_minutes % MINUTES_PER_DAY) / 60;
+  int minutes = total_minutes % 60;
+
   if (days > 0) {
-    return std::to_string(days) + "d " + std::to_string(hours) + "h " + std::to_string(minutes) + "m";
+    snprintf(countdown_text, sizeof(countdown_text), "%dd %dh", days, hours);
+  } else if (hours > 0 && minutes > 0) {
+    snprintf(countdown_text, sizeof(countdown_text), "%dh %dm", hours, minutes);
   } else if (hours > 0) {
-    return std::to_string(hours) + "h " + std::to_string(minutes) + "m";
+    snprintf(countdown_text, sizeof(countdown_text), "%dh", hours);
   } else {
-    return std::to_string(minutes) + "m";
+    snprintf(countdown_text, sizeof(countdown_text), "%dm", minutes);
+  }
+  return countdown_text;
+}
+
+// Hours until a bin's next scheduled start, for its countdown sensor: 0
+// while it is due, NAN if it is disabled or has nothing planned
+float calculate_countdown_hours(int pump_num) {
+  FLOOD_TIMED(TIMING_COUNTDOWN);
+  auto now = shelf_now();
+  if (!now.is_valid()) {
+    return NAN;
+  }
+  int32_t next_fire = get_next_fire_time(pump_num, now);
+  if (next_fire == ShelfState<FLOOD_BIN_COUNT>::NONE) {
+    return NAN;
+  }
+  if (next_fire <= now.timestamp) {
+    return 0.0;
+  }
+  return (next_fire - now.timestamp) / 3600.0;
+}
+
+// Countdown to a bin's next start as text, from the same next start the
+// shelf state publishes. Returns a static buffer or a literal.
+const char *calculate_countdown_text(int pump_num) {
+  FLOOD_TIMED(TIMING_COUNTDOWN);
+  if (!get_bin_enable(pump_num)) {
+    return "Disabled";
+  }
+  auto now = shelf_now();
+  if (!now.is_valid()) {
+    return "Unknown";
+  }
+  int32_t next_fire = get_next_fire_time(pump_num, now);
+  if (next_fire == ShelfState<FLOOD_BIN_COUNT>::NONE) {
+    return "No times configured";
+  }
+  if (next_fire <= now.timestamp) {
+    return "Due now";
   }
+  return format_countdown_minutes((int)((next_fire - now.timestamp + 59) / 60));
 }
 
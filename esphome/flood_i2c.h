@@ -0,0 +1,25 @@
+#pragma once
+
+#include "esphome.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Raw I2C access for the helpers that talk to chips themselves (pump driver
+// boards, multiplexed range sensors) rather than through an ESPHome
+// component. A config binds them to one of its buses with FLOOD_I2C_WRITE
+// and FLOOD_I2C_WRITE_READ.
+
+// Write len bytes to a 7-bit address; true on ACK
+using I2CWrite = bool (*)(uint8_t address, const uint8_t *data, size_t len);
+
+// Write a register address, then read len bytes after a repeated start
+using I2CWriteRead = bool (*)(uint8_t address, const uint8_t *reg, size_t reg_len, uint8_t *data, size_t len);
+
+#define FLOOD_I2C_WRITE(bus) \
+  [](uint8_t address, const uint8_t *data, size_t len) { return id(bus).write(address, data, len) == i2c::ERROR_OK; }
+#define FLOOD_I2C_WRITE_READ(bus) \
+  [](uint8_t address, const uint8_t *reg, size_t reg_len, uint8_t *data, size_t len) { \
+    return id(bus).write(address, reg, reg_len, false) == i2c::ERROR_OK && \
+           id(bus).read(address, data, len) == i2c::ERROR_OK; \
+  }
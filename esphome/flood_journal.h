@@ -0,0 +1,86 @@
+#pragma once
+
+#include "esphome.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Append-only record journal in flash
+//
+// Keeps the newest copy of a fixed-size record in a ring of SLOTS preference
+// slots. Each append goes to the slot after the last one written, tagged with
+// a sequence number and a CRC, so flash wear is spread over the ring and a
+// write torn by a power cut only loses that record: replay on boot takes the
+// valid slot with the highest sequence. Callers decide when to append; the
+// journal itself never writes on its own.
+
+// CRC-32 (IEEE 802.3), bitwise: records are small and written rarely
+uint32_t journal_crc32(const uint8_t *data, size_t length) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+template<typename T, size_t SLOTS> class FlashJournal {
+  static_assert(SLOTS >= 2, "a journal needs at least two slots");
+
+ public:
+  explicit FlashJournal(uint32_t key) : key_(key) {}
+
+  // Open the slots and replay them into out; false if none is valid, which
+  // leaves out untouched. Call once at boot, before any append().
+  bool restore(T &out) {
+    bool found = false;
+    for (size_t i = 0; i < SLOTS; i++) {
+      this->prefs_[i] = global_preferences->make_preference<Slot>(this->key_ + i, true);
+      Slot slot;
+      if (!this->prefs_[i].load(&slot) || slot.crc != crc_of(slot)) continue;
+      if (!found || (int32_t)(slot.sequence - this->sequence_) > 0) {
+        this->sequence_ = slot.sequence;
+        this->next_ = (i + 1) % SLOTS;
+        out = slot.record;
+        found = true;
+      }
+    }
+    this->open_ = true;
+    return found;
+  }
+
+  // Write record to the next slot in the ring and commit it
+  bool append(const T &record) {
+    if (!this->open_) return false;
+    Slot slot{};
+    slot.sequence = this->sequence_ + 1;
+    slot.record = record;
+    slot.crc = crc_of(slot);
+    if (!this->prefs_[this->next_].save(&slot) || !global_preferences->sync()) return false;
+    this->sequence_ = slot.sequence;
+    this->next_ = (this->next_ + 1) % SLOTS;
+    this->writes_++;
+    return true;
+  }
+
+  // Appends since boot
+  uint32_t writes() const { return this->writes_; }
+
+ protected:
+  struct Slot {
+    uint32_t sequence;
+    T record;
+    uint32_t crc;
+  };
+
+  static uint32_t crc_of(const Slot &slot) {
+    return journal_crc32(reinterpret_cast<const uint8_t *>(&slot), offsetof(Slot, crc));
+  }
+
+  uint32_t key_;
+  ESPPreferenceObject prefs_[SLOTS];
+  uint32_t sequence_ = 0;
+  size_t next_ = 0;
+  uint32_t writes_ = 0;
+  bool open_ = false;
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "esphome.h"
+
+#include <cstdint>
+#include <cstdio>
+
+#ifdef USE_ESP32
+#include <esp_heap_caps.h>
+#endif
+
+// Execution time and heap instrumentation
+//
+// FLOOD_TIMED(slot) at the top of a helper or lambda times it into one of a
+// few named slots: min/avg/max since boot, plus a max over the current
+// window that a diagnostic sensor takes and resets each time it publishes.
+// Timing costs two micros() reads per measured call. Set
+// FLOOD_TIMING_SAMPLE_EVERY (build flag) above 1 to measure only one call
+// in that many per slot.
+
+#ifndef FLOOD_TIMING_SAMPLE_EVERY
+#define FLOOD_TIMING_SAMPLE_EVERY 1
+#endif
+
+enum TimingSlot : uint8_t {
+  TIMING_SCHEDULER,  // run_budgeted_scheduler / run_bin_schedule
+  TIMING_COUNTDOWN,  // countdown sensors and calculate_countdown_*
+  TIMING_DEPTH,      // on_distance_sample
+  TIMING_PHASE,      // set_pump_phase, including the status publish
+  TIMING_JOURNAL,    // service_schedule_journal
+  TIMING_SLOT_COUNT,
+};
+
+const char *timing_slot_name(TimingSlot slot) {
+  switch (slot) {
+    case TIMING_SCHEDULER: return "sched";
+    case TIMING_COUNTDOWN: return "countdown";
+    case TIMING_DEPTH: return "depth";
+    case TIMING_PHASE: return "phase";
+    case TIMING_JOURNAL: return "journal";
+    default: return "?";
+  }
+}
+
+struct TimingStat {
+  uint32_t count = 0;
+  uint64_t total_us = 0;
+  uint32_t min_us = UINT32_MAX;
+  uint32_t max_us = 0;
+  uint32_t window_max_us = 0;
+  uint32_t skip = 0;  // calls left before the next measured one
+
+  void add(uint32_t us) {
+    this->count++;
+    this->total_us += us;
+    if (us < this->min_us) this->min_us = us;
+    if (us > this->max_us) this->max_us = us;
+    if (us > this->window_max_us) this->window_max_us = us;
+  }
+  uint32_t avg_us() const { return this->count ? (uint32_t)(this->total_us / this->count) : 0; }
+};
+
+static TimingStat timing_stats[TIMING_SLOT_COUNT];
+
+// Times the enclosing scope into a slot
+class ScopedTiming {
+ public:
+  explicit ScopedTiming(TimingSlot slot) : stat_(timing_stats[slot]) {
+    if (this->stat_.skip > 0) {
+      this->stat_.skip--;
+      return;
+    }
+    this->stat_.skip = FLOOD_TIMING_SAMPLE_EVERY - 1;
+    this->sampled_ = true;
+    this->start_us_ = micros();
+  }
+  ~ScopedTiming() {
+    if (this->sampled_) this->stat_.add(micros() - this->start_us_);
+  }
+
+ protected:
+  TimingStat &stat_;
+  uint32_t start_us_ = 0;
+  bool sampled_ = false;
+};
+
+#define FLOOD_TIMED(slot) ScopedTiming flood_timed_scope_(slot)
+
+// Largest time of a slot since the last call, for a dashboard graph; NAN if
+// nothing was measured in between
+float take_timing_window_max(TimingSlot slot) {
+  TimingStat &stat = timing_stats[slot];
+  if (stat.window_max_us == 0) return NAN;
+  float max_us = stat.window_max_us;
+  stat.window_max_us = 0;
+  return max_us;
+}
+
+// Every measured slot as "sched 120/340/900 ...", min/avg/max in us since
+// boot. Returns a static buffer, overwritten by the next call.
+const char *format_timing_stats() {
+  static char out[TIMING_SLOT_COUNT * 48 + 1];
+  size_t length = 0;
+  out[0] = '\0';
+  for (int slot = 0; slot < TIMING_SLOT_COUNT && length < sizeof(out); slot++) {
+    const TimingStat &stat = timing_stats[slot];
+    if (stat.count == 0) continue;
+    length += snprintf(out + length, sizeof(out) - length, "%s%s %u/%u/%u", length ? " " : "",
+                       timing_slot_name((TimingSlot) slot), (unsigned) stat.min_us, (unsigned) stat.avg_us(),
+                       (unsigned) stat.max_us);
+  }
+  return out;
+}
+
+struct HeapStats {
+  uint32_t free_bytes = 0;
+  uint32_t min_free_bytes = 0;  // low-water mark since boot
+  uint32_t largest_block = 0;
+  float fragmentation = 0;      // percent of free heap not in the largest block
+};
+
+HeapStats read_heap_stats() {
+  HeapStats heap;
+#ifdef USE_ESP32
+  heap.free_bytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  heap.min_free_bytes = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+  heap.largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+#endif
+  if (heap.free_bytes > 0) {
+    heap.fragmentation = 100.0f - heap.largest_block * 100.0f / heap.free_bytes;
+  }
+  return heap;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Compiled watering schedules
+//
+// The daily-times input_text is parsed once, when Home Assistant changes it,
+// into a 24-bit hour mask plus the minute each set hour fires at. The minute
+// tick and the countdown sensors then find the next fire time with a couple
+// of bit operations instead of re-parsing the text on every call.
+//
+// Accepted daily-times syntax (comma separated, whitespace ignored):
+//   "10"        10:00
+//   "6:30"      06:30
+//   "8-18"      every hour from 08:00 to 18:00
+//   "8-18/2"    08:00, 10:00, ... 18:00
+//   "*/6"       00:00, 06:00, 12:00, 18:00
+//   "*"         every hour
+
+static const int MINUTES_PER_DAY = 24 * 60;
+
+struct CompiledSchedule {
+  uint32_t hour_mask = 0;    // bit h set = fires during hour h
+  uint8_t minute[24] = {0};  // minute past the hour for each set bit
+};
+
+// Parse an unsigned number of at most 2 digits no larger than max_value
+static bool parse_schedule_number(const char *&p, const char *end, int max_value, int &out) {
+  int value = 0;
+  int digits = 0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    if (++digits > 2) return false;
+    value = value * 10 + (*p - '0');
+    p++;
+  }
+  if (digits == 0 || value > max_value) return false;
+  out = value;
+  return true;
+}
+
+// Add one fire time, rejecting two different minutes in the same hour
+static bool add_schedule_time(CompiledSchedule &out, int hour, int minute) {
+  uint32_t bit = 1u << hour;
+  if ((out.hour_mask & bit) && out.minute[hour] != minute) return false;
+  out.hour_mask |= bit;
+  out.minute[hour] = minute;
+  return true;
+}
+
+// Compile one comma-separated entry (already trimmed, never empty)
+static bool compile_schedule_entry(const char *p, const char *end, CompiledSchedule &out) {
+  int first = 0, last = 23, step = 1, minute = 0;
+
+  if (*p == '*') {
+    p++;
+  } else {
+    if (!parse_schedule_number(p, end, 23, first)) return false;
+    last = first;
+    if (p < end && *p == ':') {
+      p++;
+      if (!parse_schedule_number(p, end, 59, minute)) return false;
+      return p == end && add_schedule_time(out, first, minute);
+    }
+    if (p < end && *p == '-') {
+      p++;
+      if (!parse_schedule_number(p, end, 23, last) || last < first) return false;
+    }
+  }
+
+  if (p < end && *p == '/') {
+    p++;
+    if (!parse_schedule_number(p, end, 23, step) || step == 0) return false;
+  }
+  if (p != end) return false;
+
+  for (int hour = first; hour <= last; hour += step) {
+    if (!add_schedule_time(out, hour, 0)) return false;
+  }
+  return true;
+}
+
+// Compile a daily-times string. Returns false (leaving out untouched) if any
+// entry is malformed; an empty string compiles to an empty schedule.
+bool compile_daily_times(const char *text, size_t len, CompiledSchedule &out) {
+  CompiledSchedule compiled;
+  const char *p = text;
+  const char *end = text + len;
+
+  while (p < end) {
+    const char *entry_end = p;
+    while (entry_end < end && *entry_end != ',') entry_end++;
+
+    const char *a = p;
+    const char *b = entry_end;
+    while (a < b && (*a == ' ' || *a == '\t')) a++;
+    while (b > a && (b[-1] == ' ' || b[-1] == '\t')) b--;
+    if (a < b && !compile_schedule_entry(a, b, compiled)) return false;
+
+    p = entry_end < end ? entry_end + 1 : end;
+  }
+
+  out = compiled;
+  return true;
+}
+
+// True if the schedule fires at exactly hour:minute
+bool schedule_fires_at(const CompiledSchedule &schedule, int hour, int minute) {
+  return ((schedule.hour_mask >> hour) & 1u) && schedule.minute[hour] == minute;
+}
+
+// Minutes from hour:minute until the next fire strictly after it, or -1 if
+// the schedule is empty
+int minutes_until_next_fire(const CompiledSchedule &schedule, int hour, int minute) {
+  if (schedule.hour_mask == 0) return -1;
+
+  int now = hour * 60 + minute;
+  if (((schedule.hour_mask >> hour) & 1u) && schedule.minute[hour] > minute) {
+    return schedule.minute[hour] - minute;
+  }
+
+  uint32_t later = schedule.hour_mask & ~((2u << hour) - 1u);
+  if (later != 0) {
+    int next_hour = __builtin_ctz(later);
+    return next_hour * 60 + schedule.minute[next_hour] - now;
+  }
+
+  int first_hour = __builtin_ctz(schedule.hour_mask);
+  return MINUTES_PER_DAY - now + first_hour * 60 + schedule.minute[first_hour];
+}
+
+// Minutes until the next interval-days run at fire_hour:00. days_since is
+// the number of days since the last run, or -1 if the bin has never run.
+int minutes_until_interval_fire(int interval_days, int fire_hour, int days_since, int hour, int minute) {
+  int now = hour * 60 + minute;
+  int fire = fire_hour * 60;
+
+  if (days_since < 0 || days_since >= interval_days) {
+    return fire > now ? fire - now : MINUTES_PER_DAY - now + fire;
+  }
+  return (interval_days - days_since) * MINUTES_PER_DAY + fire - now;
+}
+
+// One bin's schedule, as the wake-up calculation sees it
+struct BinSchedule {
+  bool enabled;
+  bool daily_times;                  // daily-times mode, else interval days
+  const CompiledSchedule *schedule;  // compiled daily times
+  int interval_days;
+  int fire_hour;                     // interval-days run hour
+  int days_since;                    // days since the last run, -1 if never
+};
+
+// Minutes from hour:minute until the first fire of any enabled bin strictly
+// after it, or -1 if none will fire
+int minutes_until_any_fire(const BinSchedule *schedules, size_t count, int hour, int minute) {
+  int first = -1;
+  for (size_t i = 0; i < count; i++) {
+    const BinSchedule &bin = schedules[i];
+    if (!bin.enabled) continue;
+    int minutes = bin.daily_times ? minutes_until_next_fire(*bin.schedule, hour, minute)
+                                  : minutes_until_interval_fire(bin.interval_days, bin.fire_hour, bin.days_since,
+                                                                hour, minute);
+    if (minutes >= 0 && (first < 0 || minutes < first)) first = minutes;
+  }
+  return first;
+}
+
+// Seconds an idle shelf can sleep at hour:minute:second: until the start of
+// the minute the next schedule fires in (minutes_until, -1 for none) or the
+// next timer (timer_s, 0 for none), whichever comes first; 1..max_s
+uint32_t next_wake_s(int minutes_until, int second, uint32_t timer_s, uint32_t max_s) {
+  uint32_t wake = max_s;
+  if (minutes_until >= 0) {
+    int32_t fire_s = minutes_until * 60 - second;
+    wake = fire_s < 1 ? 1 : (uint32_t) fire_s < wake ? (uint32_t) fire_s : wake;
+  }
+  if (timer_s > 0 && timer_s < wake) wake = timer_s;
+  return wake < 1 ? 1 : wake;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "bin_set.h"
+
+// Bin table for floodshelf.yaml: four time-based bins
+#define FLOOD_BIN_COUNT 4
+
+#define FLOODSHELF_BIN(n, speed_output, forward_pin, reverse_pin, pump_drive) \
+  { \
+    .enable = FLOOD_STATE(bin_##n##_enable), \
+    .cycle_interval = FLOOD_STATE(pump_##n##_cycle_interval), \
+    .fill_duration = FLOOD_STATE(pump_##n##_fill_duration), \
+    .soak_duration = FLOOD_STATE(pump_##n##_soak_duration), \
+    .drain_duration = FLOOD_STATE(pump_##n##_drain_duration), \
+    .fill_speed = FLOOD_STATE(pump_##n##_fill_speed), \
+    .drain_speed = FLOOD_STATE(pump_##n##_drain_speed), \
+    .last_cycle = FLOOD_GLOBAL(pump_##n##_last_cycle), \
+    .publish_status = FLOOD_PUBLISH(pump_##n##_status), \
+    .update_countdown = FLOOD_UPDATE(pump_##n##_countdown), \
+    .pump_on = FLOOD_STATE(pump_##n), \
+    .reverse = FLOOD_STATE(pump_##n##_reverse), \
+    .set_direction = FLOOD_HBRIDGE(forward_pin, reverse_pin), \
+    .set_speed_level = FLOOD_SET_LEVEL(speed_output), \
+    .drive = pump_drive, \
+    .set_pump = FLOOD_SWITCH(pump_##n), \
+    .set_reverse = FLOOD_SWITCH(pump_##n##_reverse), \
+  }
+
+static constexpr BinSet<FLOOD_BIN_COUNT> bins = {{
+  // HW-095 channel outputs, and the ledc channel, frequency and soft start
+  // and stop (ms) of each pump
+  FLOODSHELF_BIN(1, motor_a_speed, motor_a_in1, motor_a_in2, PUMP_DRIVE(0, 1000, 1500, 500)),
+  FLOODSHELF_BIN(2, motor_b_speed, motor_b_in3, motor_b_in4, PUMP_DRIVE(1, 1000, 1500, 500)),
+  FLOODSHELF_BIN(3, motor_c_speed, motor_c_in1, motor_c_in2, PUMP_DRIVE(2, 1000, 1500, 500)),
+  FLOODSHELF_BIN(4, motor_d_speed, motor_d_in3, motor_d_in4, PUMP_DRIVE(3, 1000, 1500, 500)),
+}};
+
+static constexpr ShelfRefs shelf = {
+  .watering_hour = FLOOD_STATE(watering_hour),
+  .supply_budget = FLOOD_STATE(supply_current_budget),
+  .pump_rated_current = FLOOD_STATE(pump_rated_current),
+  .publish_state = FLOOD_PUBLISH_RESERVED(shelf_state, 256),
+  .low_power = FLOOD_STATE(low_power_idle),
+  .set_tick_interval = FLOOD_POLL_INTERVAL(flood_tick),
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "bin_set.h"
+
+// Bin table for floodshelf_strawberry.yaml: a single depth-controlled bin
+#define FLOOD_BIN_COUNT 1
+
+static constexpr BinSet<FLOOD_BIN_COUNT> bins = {{
+  {
+    .enable = FLOOD_STATE(bin_1_enable),
+    .target_depth = FLOOD_STATE(bin_1_target_depth),
+    .empty_distance = FLOOD_STATE(bin_1_empty_distance),
+    .distance = FLOOD_STATE(bin_1_distance),
+    .set_sample_interval = FLOOD_POLL_INTERVAL(bin_1_distance),
+    .cycle_interval = FLOOD_STATE(pump_1_cycle_interval),
+    // Fill and drain end on depth (fill_end, drain_end); their durations
+    // are the timeouts
+    .fill_duration = FLOOD_STATE(bin_1_max_fill_time),
+    .soak_duration = FLOOD_STATE(pump_1_soak_duration),
+    .drain_duration = []() { return 20.0f; },
+    .fill_speed = FLOOD_STATE(pump_1_fill_speed),
+    .drain_speed = FLOOD_STATE(pump_1_drain_speed),
+    .daily_times = FLOOD_TEXT(ha_bin_1_daily_times),
+    .schedule_mode = FLOOD_GLOBAL(bin_1_schedule_mode),
+    .interval_time = FLOOD_GLOBAL(bin_1_interval_time),
+    .next_cycle = FLOOD_GLOBAL(bin_1_next_cycle),
+    .last_cycle = FLOOD_GLOBAL(pump_1_last_cycle),
+    .last_run_day = FLOOD_GLOBAL(bin_1_last_run_day),
+    .publish_status = FLOOD_PUBLISH(pump_1_status),
+    .publish_stop_latency = FLOOD_PUBLISH_VALUE(bin_1_stop_latency),
+    .publish_fill_error = FLOOD_PUBLISH_VALUE(bin_1_fill_error),
+    .update_countdown = FLOOD_UPDATE(pump_1_countdown_text),
+    .pump_on = FLOOD_STATE(pump_1),
+    .reverse = FLOOD_STATE(pump_1_reverse),
+    .set_direction = FLOOD_HBRIDGE(motor_a_in1, motor_a_in2),
+    .set_speed_level = FLOOD_SET_LEVEL(motor_a_speed),
+    .drive = PUMP_DRIVE(0, 1000, 1500, 500),  // ledc channel, Hz, soft start and stop ms
+    .set_pump = FLOOD_SWITCH(pump_1),
+    .set_reverse = FLOOD_SWITCH(pump_1_reverse),
+    .fill_end = CycleEnd::DEPTH,
+    .drain_end = CycleEnd::DEPTH,
+    .drain_plateau_rate = FLOOD_STATE(bin_1_drain_plateau_rate),
+    .drain_plateau_window = FLOOD_STATE(bin_1_drain_plateau_window),
+    .auto_calibrate = FLOOD_STATE(bin_1_auto_calibrate),
+    // The Water Depth sensor's zero moves with the empty distance
+    .set_empty_distance =
+        [](float mm) {
+          float &zero_offset = id(bin_1_sensor_zero_offset).value();
+          if (zero_offset != 0.0f) zero_offset += mm - id(bin_1_empty_distance).state;
+          auto call = id(bin_1_empty_distance).make_call();
+          call.set_value(mm);
+          call.perform();
+        },
+    .publish_calibration_confidence = FLOOD_PUBLISH_VALUE(bin_1_calibration_confidence),
+  },
+}};
+
+// Per-bin schedules only: no shelf-wide scheduler settings
+static constexpr ShelfRefs shelf = {
+  .publish_state = FLOOD_PUBLISH_RESERVED(shelf_state, 256),
+  .low_power = FLOOD_STATE(low_power_idle),
+  .set_tick_interval = FLOOD_POLL_INTERVAL(flood_tick),
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "esphome.h"
+
+#include <cstdint>
+
+#ifdef USE_ESP32
+#include <driver/ledc.h>
+#include <esp_idf_version.h>
+#endif
+
+// Soft-start and soft-stop for the pump speed outputs
+//
+// A pump's speed output is an ESPHome ledc output on the H-bridge enable
+// pin. Instead of writing the new duty at once, the ramp is handed to the
+// LEDC fade engine, which steps the duty in hardware over the given time, so
+// no loop or timer runs on the CPU while a pump ramps. Each pump has its own
+// ramp profile in the config's bin table. The ledc output needs an explicit
+// `channel:` matching ledc_channel; anything else falls back to an immediate
+// set_level().
+
+struct PumpDrive {
+  int8_t ledc_channel = -1;     // channel of the ledc speed output, -1 for no fades
+  uint32_t frequency = 1000;    // Hz, as set on the ledc output
+  uint16_t soft_start_ms = 0;   // ramp from stopped to the set speed
+  uint16_t soft_stop_ms = 0;    // ramp from running to stopped
+};
+
+#define PUMP_DRIVE(channel, frequency, soft_start_ms, soft_stop_ms) \
+  PumpDrive { channel, frequency, soft_start_ms, soft_stop_ms }
+
+#ifdef USE_ESP32
+// Duty resolution ESPHome's ledc output picks for a frequency, which the
+// fade's target duty has to be scaled to. The output doesn't expose it, so
+// this mirrors ledc_bit_depth_for_frequency() in ESPHome 2025.8's
+// components/ledc/ledc_output.cpp: the most bits, up to one under the chip's
+// LEDC_TIMER_BIT_MAX, whose frequency range at the 80 MHz APB clock holds the
+// frequency. Re-check it against ledc_output.cpp when moving past that
+// version; the build warns until PUMP_DRIVE_LEDC_CHECKED is bumped.
+#define PUMP_DRIVE_LEDC_CHECKED VERSION_CODE(2025, 8, 0)
+#if ESPHOME_VERSION_CODE > PUMP_DRIVE_LEDC_CHECKED
+#warning "ledc_bit_depth() not checked against this ESPHome's ledc_output.cpp"
+#endif
+
+uint8_t ledc_bit_depth(uint32_t frequency) {
+  static const int MAX_RES_BITS = LEDC_TIMER_BIT_MAX - 1;
+  static const float CLOCK_HZ = 80000000.0f;
+  for (int bits = MAX_RES_BITS; bits >= 1; bits--) {
+    float max_div = ((1 << MAX_RES_BITS) - 1) / (frequency < 100 ? 32.0f : 256.0f);
+    float min_hz = CLOCK_HZ / (max_div * (float) (1u << bits));
+    float max_hz = CLOCK_HZ / (float) (1u << bits);
+    if (min_hz <= frequency && frequency <= max_hz) return bits;
+  }
+  return 0;  // ESPHome fails the output's setup
+}
+#endif
+
+// Fade a pump's speed output to level over ms; false if the drive can't fade
+// (not LEDC, or not an ESP32), in which case the caller sets the level itself
+bool ledc_fade_to(const PumpDrive &drive, float level, uint32_t ms) {
+#ifdef USE_ESP32
+  if (drive.ledc_channel < 0 || ms == 0) return false;
+  static bool fade_installed = false;
+  if (!fade_installed) {
+    esp_err_t err = ledc_fade_func_install(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return false;
+    fade_installed = true;
+  }
+  // Same channel mapping as ESPHome's ledc output
+#ifdef SOC_LEDC_SUPPORT_HS_MODE
+  ledc_mode_t mode = drive.ledc_channel < 8 ? LEDC_HIGH_SPEED_MODE : LEDC_LOW_SPEED_MODE;
+#else
+  ledc_mode_t mode = LEDC_LOW_SPEED_MODE;
+#endif
+  ledc_channel_t channel = (ledc_channel_t)(drive.ledc_channel % 8);
+  uint8_t bits = ledc_bit_depth(drive.frequency);
+  if (bits == 0) return false;
+  if (level < 0) level = 0;
+  if (level > 1) level = 1;
+  uint32_t duty = (uint32_t) roundf(level * ((1u << bits) - 1));
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+  ledc_fade_stop(mode, channel);  // a new ramp replaces one still running
+#endif
+  return ledc_set_fade_time_and_start(mode, channel, duty, ms, LEDC_FADE_NO_WAIT) == ESP_OK;
+#else
+  (void) drive;
+  (void) level;
+  (void) ms;
+  return false;
+#endif
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "esphome.h"
+#include "flood_i2c.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Pump outputs on I2C driver boards
+//
+// Past four pumps the ESP32 runs out of pins for three signals per H-bridge
+// channel, so larger shelves put the speed PWM on a PCA9685 and the
+// direction pins on a PCF8574/PCF8575 or MCP23017 expander. Both classes here
+// keep a shadow of the chip's outputs: setting a channel only touches the
+// shadow, and flush() sends everything that changed in one bus transaction
+// per chip. The bin table's set_speed_level and set_direction entries write
+// the shadows (PCA9685_LEVEL, EXPANDER_HBRIDGE), and ShelfRefs::flush_outputs
+// flushes them at the end of each PumpOutputBatch, so starting or stopping
+// any number of pumps costs one write per chip.
+//
+// A shelf on direct GPIO and ledc outputs doesn't use any of this: its table
+// entries call the ESPHome outputs directly and it has no flush_outputs.
+
+// 16-channel 12-bit PWM driver
+class Pca9685Bank {
+ public:
+  static const uint8_t CHANNELS = 16;
+
+  Pca9685Bank(I2CWrite write, uint8_t address) : write_(write), address_(address) {}
+
+  // Set the PWM frequency and wake the chip; call once from on_boot
+  bool setup(float frequency) {
+    int prescale = (int) roundf(25000000.0f / (4096 * frequency)) - 1;
+    prescale = prescale < 3 ? 3 : prescale > 255 ? 255 : prescale;
+    if (!this->write_reg(MODE1, MODE1_AI | MODE1_SLEEP) || !this->write_reg(PRESCALE, prescale) ||
+        !this->write_reg(MODE1, MODE1_AI))
+      return false;
+    delayMicroseconds(500);  // oscillator start-up
+    if (!this->write_reg(MODE1, MODE1_AI | MODE1_RESTART) || !this->write_reg(MODE2, MODE2_OUTDRV)) return false;
+    this->dirty_ = 0xFFFF;
+    return this->flush();
+  }
+
+  // Duty of a channel, 0..1; 0 and 1 use the chip's full-off and full-on bits
+  void set_level(uint8_t channel, float level) {
+    if (channel >= CHANNELS) return;
+    uint16_t counts = level <= 0 ? 0 : level >= 1 ? FULL : (uint16_t) roundf(level * FULL);
+    if (this->counts_[channel] == counts) return;
+    this->counts_[channel] = counts;
+    this->dirty_ |= 1 << channel;
+  }
+
+  // A channel used as a plain on/off signal, e.g. an H-bridge direction pin
+  void set_on(uint8_t channel, bool on) { this->set_level(channel, on ? 1.0f : 0.0f); }
+
+  // Write every changed channel: the span from the first to the last changed
+  // one, in a single auto-increment transaction
+  bool flush() {
+    if (this->dirty_ == 0) return true;
+    uint8_t first = __builtin_ctz(this->dirty_);
+    uint8_t last = 15 - __builtin_clz((uint32_t) this->dirty_ << 16);
+    uint8_t data[1 + 4 * CHANNELS];
+    size_t length = 0;
+    data[length++] = LED0_ON_L + 4 * first;
+    for (uint8_t channel = first; channel <= last; channel++) {
+      uint16_t counts = this->counts_[channel];
+      uint16_t on = counts == FULL ? FULL_BIT : 0;
+      uint16_t off = counts == 0 ? FULL_BIT : counts == FULL ? 0 : counts;
+      data[length++] = on & 0xFF;
+      data[length++] = on >> 8;
+      data[length++] = off & 0xFF;
+      data[length++] = off >> 8;
+    }
+    if (!this->write_(this->address_, data, length)) return false;
+    this->dirty_ = 0;
+    return true;
+  }
+
+ protected:
+  static const uint8_t MODE1 = 0x00;
+  static const uint8_t MODE2 = 0x01;
+  static const uint8_t LED0_ON_L = 0x06;
+  static const uint8_t PRESCALE = 0xFE;
+  static const uint8_t MODE1_RESTART = 0x80;
+  static const uint8_t MODE1_AI = 0x20;
+  static const uint8_t MODE1_SLEEP = 0x10;
+  static const uint8_t MODE2_OUTDRV = 0x04;
+  static const uint16_t FULL = 4096;
+  static const uint16_t FULL_BIT = 0x1000;
+
+  bool write_reg(uint8_t reg, uint8_t value) {
+    uint8_t data[2] = {reg, value};
+    return this->write_(this->address_, data, sizeof(data));
+  }
+
+  I2CWrite write_;
+  uint8_t address_;
+  uint16_t counts_[CHANNELS] = {};
+  uint16_t dirty_ = 0;  // one bit per channel
+};
+
+enum class ExpanderKind : uint8_t {
+  PCF857X,   // PCF8574 (8 pins) or PCF8575 (16 pins): the port is written raw
+  MCP23017,  // 16 pins behind IODIR/OLAT registers, BANK=0
+};
+
+// 8- or 16-pin GPIO expander used for outputs only
+template<size_t PINS> class ExpanderPort {
+  static_assert(PINS == 8 || PINS == 16, "an expander port has 8 or 16 pins");
+
+ public:
+  ExpanderPort(I2CWrite write, uint8_t address, ExpanderKind kind) : write_(write), address_(address), kind_(kind) {}
+
+  // Make every pin an output, driven low; call once from on_boot
+  bool setup() {
+    if (this->kind_ == ExpanderKind::MCP23017) {
+      uint8_t iodir[1 + BYTES] = {IODIRA};  // all zero: outputs
+      if (!this->write_(this->address_, iodir, sizeof(iodir))) return false;
+    }
+    this->dirty_ = true;
+    return this->flush();
+  }
+
+  void set(uint8_t pin, bool on) {
+    if (pin >= PINS) return;
+    uint16_t bits = on ? this->bits_ | (1 << pin) : this->bits_ & ~(1 << pin);
+    if (bits == this->bits_) return;
+    this->bits_ = bits;
+    this->dirty_ = true;
+  }
+
+  // Write the whole port in one transaction if any pin changed
+  bool flush() {
+    if (!this->dirty_) return true;
+    uint8_t data[1 + BYTES];
+    size_t length = 0;
+    if (this->kind_ == ExpanderKind::MCP23017) data[length++] = OLATA;
+    for (size_t i = 0; i < BYTES; i++) data[length++] = (this->bits_ >> (8 * i)) & 0xFF;
+    if (!this->write_(this->address_, data, length)) return false;
+    this->dirty_ = false;
+    return true;
+  }
+
+ protected:
+  static const size_t BYTES = PINS / 8;
+  static const uint8_t IODIRA = 0x00;
+  static const uint8_t OLATA = 0x14;
+
+  I2CWrite write_;
+  uint8_t address_;
+  ExpanderKind kind_;
+  uint16_t bits_ = 0;
+  bool dirty_ = false;
+};
+
+// Bin table entries for pumps on driver boards
+#define PCA9685_LEVEL(bank, channel) [](float level) { bank.set_level(channel, level); }
+#define EXPANDER_HBRIDGE(port, forward_pin, reverse_pin) \
+  [](bool forward, bool reverse) { \
+    port.set(forward_pin, forward); \
+    port.set(reverse_pin, reverse); \
+  }
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Pump phases, one-hot so whole-shelf questions are a single mask test
+enum class PumpPhase : uint8_t {
+  IDLE = 0,
+  FILLING = 1,
+  SOAKING = 2,
+  DRAINING = 4,
+  FAULT = 8,
+};
+
+// How a bin's fill or drain ends
+enum class CycleEnd : uint8_t {
+  TIMED,  // after the bin's fill or drain duration
+  DEPTH,  // when the depth says so, with the duration as a timeout
+};
+
+// Human-readable phase, only needed where it is published to Home Assistant
+const char *pump_phase_text(PumpPhase phase) {
+  switch (phase) {
+    case PumpPhase::IDLE: return "Idle";
+    case PumpPhase::FILLING: return "Filling";
+    case PumpPhase::SOAKING: return "Soaking";
+    case PumpPhase::DRAINING: return "Draining";
+    case PumpPhase::FAULT: return "Fault";
+  }
+  return "Unknown";
+}
+
+// Phases of every bin packed 4 bits per bin into one atomic word, so reading
+// a phase never allocates and "is anything running" is one load and compare.
+template<size_t N> class PumpStates {
+  static_assert(N >= 1 && N <= 16, "PumpStates packs at most 16 bins");
+
+ public:
+  using Word = typename std::conditional<(N <= 8), uint32_t, uint64_t>::type;
+
+  // Phase of bin_num (1-based); out-of-range bins read as idle
+  PumpPhase get(int bin_num) const {
+    if (bin_num < 1 || bin_num > (int)N) return PumpPhase::IDLE;
+    return (PumpPhase)((this->word_.load(std::memory_order_relaxed) >> shift(bin_num)) & 0xF);
+  }
+
+  // Set the phase of bin_num; returns the previous phase
+  PumpPhase set(int bin_num, PumpPhase phase) {
+    if (bin_num < 1 || bin_num > (int)N) return PumpPhase::IDLE;
+    Word clear = ~((Word) 0xF << shift(bin_num));
+    Word bits = (Word) phase << shift(bin_num);
+    Word old_word = this->word_.load(std::memory_order_relaxed);
+    while (!this->word_.compare_exchange_weak(old_word, (old_word & clear) | bits)) {
+    }
+    return (PumpPhase)((old_word >> shift(bin_num)) & 0xF);
+  }
+
+  // Whole word, for snapshotting every bin at once
+  Word word() const { return this->word_.load(std::memory_order_relaxed); }
+
+  // Any bin not idle
+  bool any_busy() const { return this->word() != 0; }
+
+  // Any bin in a cycle; a bin in Fault waits for someone to clear it
+  bool any_cycling() const { return (this->word() & ~phase_mask(PumpPhase::FAULT)) != 0; }
+
+  // Any bin with a pump running (filling or draining)
+  bool any_pumping() const { return (this->word() & phase_mask(PumpPhase::FILLING, PumpPhase::DRAINING)) != 0; }
+
+  // Bits of every bin that are set in any of the given phases
+  static constexpr Word phase_mask(PumpPhase a, PumpPhase b = PumpPhase::IDLE) {
+    return repeat(((Word) a | (Word) b) & 0xF);
+  }
+
+ protected:
+  static constexpr int shift(int bin_num) { return (bin_num - 1) * 4; }
+
+  // Repeat a nibble across the bins in use
+  static constexpr Word repeat(Word nibble) {
+    Word out = 0;
+    for (size_t i = 0; i < N; i++) out |= nibble << (i * 4);
+    return out;
+  }
+
+  std::atomic<Word> word_{0};
+};
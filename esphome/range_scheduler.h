@@ -0,0 +1,218 @@
+#pragma once
+
+#include "esphome.h"
+#include "flood_i2c.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Overlapped ranging for VL6180X sensors behind a TCA9548A multiplexer
+//
+// All the sensors share address 0x29, one per mux channel. Read one at a
+// time, each sample costs a channel select, a single-shot start and a
+// blocking wait for the conversion, so N sensors share one sensor's sample
+// rate. Here every sensor ranges at once: service() starts a conversion on
+// each sensor that is due, comes back to collect results once they can be
+// ready, and only switches the mux channel to talk to a sensor that needs
+// it. The conversions overlap, so the aggregate rate grows with the sensor
+// count until the bus itself is busy. Sensors with the shortest interval
+// (bins filling or draining, see apply_depth_sample_rate()) are visited
+// first each pass.
+
+// One multiplexed sensor: its mux channel and where its samples go (mm, NAN
+// for a failed ranging)
+struct RangeSensor {
+  uint8_t mux_channel;
+  void (*publish)(float mm);
+};
+
+template<size_t N> class MuxedRangeScheduler {
+  static_assert(N >= 1 && N <= 8, "a TCA9548A has 8 channels");
+
+ public:
+  static const uint8_t SENSOR_ADDRESS = 0x29;
+  // A conversion isn't polled before this, or given up on after the timeout
+  static const uint32_t MIN_CONVERSION_MS = 8;
+  static const uint32_t CONVERSION_TIMEOUT_MS = 100;
+
+  // sensors: N entries, in a table that outlives the scheduler
+  MuxedRangeScheduler(I2CWrite write, I2CWriteRead write_read, uint8_t mux_address, const RangeSensor *sensors)
+      : write_(write), write_read_(write_read), mux_address_(mux_address), sensors_(sensors) {
+    for (size_t i = 0; i < N; i++) this->order_[i] = i;
+  }
+
+  // Load the sensors' settings; call once from on_boot. A sensor that
+  // doesn't answer is skipped from then on.
+  bool setup() {
+    bool all = true;
+    for (size_t i = 0; i < N; i++) {
+      Slot &slot = this->slots_[i];
+      slot.state = this->select(i) && this->init_sensor() ? WAITING : FAILED;
+      if (slot.state == FAILED) {
+        ESP_LOGW("range", "VL6180X on mux channel %u not responding", this->sensors_[i].mux_channel);
+        all = false;
+      }
+    }
+    return all;
+  }
+
+  // Time between samples of sensor i, e.g. from a bin's set_sample_interval
+  void set_interval(size_t i, uint32_t ms) {
+    if (i >= N || this->slots_[i].interval_ms == ms) return;
+    Slot &slot = this->slots_[i];
+    // Moving to a faster rate takes effect now, not after the old interval
+    if (ms < slot.interval_ms && slot.state == WAITING) slot.next_ms = millis();
+    slot.interval_ms = ms;
+    // Keep order_ sorted by interval: fastest sensors get the bus first
+    for (size_t a = 1; a < N; a++) {
+      for (size_t b = a; b > 0 && this->slots_[this->order_[b]].interval_ms < this->slots_[this->order_[b - 1]].interval_ms;
+           b--) {
+        uint8_t swap = this->order_[b];
+        this->order_[b] = this->order_[b - 1];
+        this->order_[b - 1] = swap;
+      }
+    }
+  }
+
+  // Call as often as possible (every loop): collects finished conversions
+  // and starts due ones, never waiting on a sensor
+  void service() {
+    uint32_t now = millis();
+    for (size_t k = 0; k < N; k++) {
+      size_t i = this->order_[k];
+      Slot &slot = this->slots_[i];
+      if (slot.state == RANGING) {
+        if (now - slot.started_ms < MIN_CONVERSION_MS) continue;
+        if (!this->collect(i, now)) continue;
+      }
+      if (slot.state == WAITING && (int32_t)(now - slot.next_ms) >= 0) {
+        if (this->select(i) && this->write_reg(SYSRANGE_START, 0x01)) {
+          slot.state = RANGING;
+          slot.started_ms = now;
+        } else {
+          slot.next_ms = now + slot.interval_ms;
+        }
+      }
+    }
+  }
+
+  // Samples delivered and bus transactions since boot
+  uint32_t samples() const { return this->samples_; }
+  uint32_t transactions() const { return this->transactions_; }
+
+ protected:
+  enum State : uint8_t { WAITING, RANGING, FAILED };
+
+  struct Slot {
+    uint32_t interval_ms = 5000;
+    uint32_t next_ms = 0;
+    uint32_t started_ms = 0;
+    State state = WAITING;
+  };
+
+  static const uint16_t SYSTEM_INTERRUPT_CLEAR = 0x015;
+  static const uint16_t SYSTEM_FRESH_OUT_OF_RESET = 0x016;
+  static const uint16_t SYSRANGE_START = 0x018;
+  static const uint16_t RESULT_RANGE_STATUS = 0x04D;
+  static const uint16_t RESULT_INTERRUPT_STATUS_GPIO = 0x04F;
+  static const uint16_t RESULT_RANGE_VAL = 0x062;
+
+  // Read sensor i's conversion if it is done; true once the slot is free
+  // for the next start
+  bool collect(size_t i, uint32_t now) {
+    Slot &slot = this->slots_[i];
+    uint8_t status;
+    if (!this->select(i) || !this->read_reg(RESULT_INTERRUPT_STATUS_GPIO, &status)) {
+      this->finish(i, NAN, now);
+      return true;
+    }
+    if ((status & 0x07) != 0x04) {
+      if (now - slot.started_ms < CONVERSION_TIMEOUT_MS) return false;
+      this->write_reg(SYSTEM_INTERRUPT_CLEAR, 0x07);
+      this->finish(i, NAN, now);
+      return true;
+    }
+    uint8_t range = 0;
+    uint8_t error = 0;
+    bool ok = this->read_reg(RESULT_RANGE_VAL, &range) && this->read_reg(RESULT_RANGE_STATUS, &error);
+    this->write_reg(SYSTEM_INTERRUPT_CLEAR, 0x07);
+    this->finish(i, ok && (error >> 4) == 0 ? (float) range : NAN, now);
+    return true;
+  }
+
+  void finish(size_t i, float mm, uint32_t now) {
+    Slot &slot = this->slots_[i];
+    slot.state = WAITING;
+    // Keep the period from start to start, without bunching up after a stall
+    slot.next_ms = slot.started_ms + slot.interval_ms;
+    if ((int32_t)(now - slot.next_ms) > (int32_t) slot.interval_ms) slot.next_ms = now;
+    this->samples_++;
+    if (this->sensors_[i].publish != nullptr) this->sensors_[i].publish(mm);
+  }
+
+  // Route the bus to sensor i, unless it already is
+  bool select(size_t i) {
+    uint8_t mask = 1 << this->sensors_[i].mux_channel;
+    if (this->mux_mask_ == mask) return true;
+    this->transactions_++;
+    if (!this->write_(this->mux_address_, &mask, 1)) {
+      this->mux_mask_ = 0;
+      return false;
+    }
+    this->mux_mask_ = mask;
+    return true;
+  }
+
+  bool write_reg(uint16_t reg, uint8_t value) {
+    uint8_t data[3] = {(uint8_t)(reg >> 8), (uint8_t)(reg & 0xFF), value};
+    this->transactions_++;
+    return this->write_(SENSOR_ADDRESS, data, sizeof(data));
+  }
+
+  bool read_reg(uint16_t reg, uint8_t *value) {
+    uint8_t address[2] = {(uint8_t)(reg >> 8), (uint8_t)(reg & 0xFF)};
+    this->transactions_++;
+    return this->write_read_(SENSOR_ADDRESS, address, sizeof(address), value, 1);
+  }
+
+  // ST's mandatory private settings (AN4545) and the recommended ones, for
+  // single-shot ranging with a new-sample-ready status
+  bool init_sensor() {
+    static const uint16_t SETTINGS[][2] = {
+        {0x0207, 0x01}, {0x0208, 0x01}, {0x0096, 0x00}, {0x0097, 0xFD}, {0x00E3, 0x00}, {0x00E4, 0x04},
+        {0x00E5, 0x02}, {0x00E6, 0x01}, {0x00E7, 0x03}, {0x00F5, 0x02}, {0x00D9, 0x05}, {0x00DB, 0xCE},
+        {0x00DC, 0x03}, {0x00DD, 0xF8}, {0x009F, 0x00}, {0x00A3, 0x3C}, {0x00B7, 0x00}, {0x00BB, 0x3C},
+        {0x00B2, 0x09}, {0x00CA, 0x09}, {0x0198, 0x01}, {0x01B0, 0x17}, {0x01AD, 0x00}, {0x00FF, 0x05},
+        {0x0100, 0x05}, {0x0199, 0x05}, {0x01A6, 0x1B}, {0x01AC, 0x3E}, {0x01A7, 0x1F}, {0x0030, 0x00},
+        {0x0011, 0x10},  // GPIO1 interrupt output
+        {0x010A, 0x30},  // readout averaging 4.3 ms
+        {0x003F, 0x46},  // light and dark gain
+        {0x0031, 0xFF},  // auto calibration every 255 measurements
+        {0x002E, 0x01},  // temperature calibration now
+        {0x001B, 0x09},  // ranging inter-measurement 100 ms (continuous mode only)
+        {0x0014, 0x04},  // range interrupt on new sample ready
+        {SYSTEM_FRESH_OUT_OF_RESET, 0x00},
+    };
+    uint8_t fresh;
+    if (!this->read_reg(SYSTEM_FRESH_OUT_OF_RESET, &fresh)) return false;
+    if (fresh != 1) return true;  // already set up, e.g. after a soft reboot
+    for (const auto &setting : SETTINGS) {
+      if (!this->write_reg(setting[0], setting[1])) return false;
+    }
+    return true;
+  }
+
+  I2CWrite write_;
+  I2CWriteRead write_read_;
+  uint8_t mux_address_;
+  const RangeSensor *sensors_;
+  Slot slots_[N];
+  uint8_t order_[N];
+  uint8_t mux_mask_ = 0;
+  uint32_t samples_ = 0;
+  uint32_t transactions_ = 0;
+};
+
+// Bin table entry: a bin's sample rate drives its sensor's interval
+#define RANGE_INTERVAL(scheduler, index) [](uint32_t ms) { scheduler.set_interval(index, ms); }
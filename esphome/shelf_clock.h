@@ -0,0 +1,117 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <ctime>
+
+// Shelf wall clock
+//
+// Every schedule decision needs the wall-clock time, and ESPHome's time is
+// invalid from boot until a time source (Home Assistant, SNTP, an RTC chip's
+// read_time) first sets it. The shelf clock keeps its own: a wall time at an
+// anchor plus millis() since, re-anchored whenever a source reports a valid
+// time and moved up on every read, so millis() wrapping every 49 days
+// doesn't matter as long as it is read more often than that. Once set, it
+// runs on through source outages.
+//
+// Each tick the clock's time goes to a ClockCheckpoint in RTC memory, which a
+// reset leaves alone; on the next boot the clock resumes from it straight
+// away, a tick and the boot time behind, and the first source corrects it. A
+// power cut clears RTC memory, and then the clock waits for a source. A
+// source earlier than the last known time (the latest cycle start the
+// schedule journal has in flash) is rejected: that is an RTC chip that lost
+// its battery, not the time. SNTP is trusted over that floor, so a wrong
+// time that once reached the journal can't lock out every later source.
+
+enum class ClockSource : uint8_t {
+  NONE,     // no time yet
+  RESUMED,  // resumed from RTC memory after a reset
+  SYNCED,   // set by a time source
+};
+
+class ShelfClock {
+ public:
+  // A sync further from the clock than this is logged as a step
+  static const int32_t STEP_LOG_S = 2;
+
+  bool valid() const { return this->source_ != ClockSource::NONE; }
+  ClockSource source() const { return this->source_; }
+
+  // Wall time at now_ms, or 0 while not valid
+  time_t now(uint32_t now_ms) {
+    if (!this->valid()) return 0;
+    uint32_t elapsed_s = (now_ms - this->anchor_ms_) / 1000;
+    this->anchor_ += elapsed_s;
+    this->anchor_ms_ += elapsed_s * 1000;
+    return this->anchor_;
+  }
+
+  // A source reports wall; returns the step from the clock's own time in
+  // seconds (0 on the first sync), or NO_STEP if the time was rejected
+  static const int32_t NO_STEP = INT32_MIN;
+  int32_t sync(time_t wall, uint32_t now_ms) {
+    if (wall < this->floor_) return NO_STEP;
+    int32_t step = this->valid() ? (int32_t)(wall - this->now(now_ms)) : 0;
+    this->anchor_ = wall;
+    this->anchor_ms_ = now_ms;
+    this->source_ = ClockSource::SYNCED;
+    return step;
+  }
+
+  // A source trusted over the floor: one behind it lowers the floor to it
+  int32_t trust(time_t wall, uint32_t now_ms) {
+    if (wall < this->floor_) this->floor_ = wall;
+    return this->sync(wall, now_ms);
+  }
+
+  // Start from a time saved before a reset; ignored once a source synced
+  void resume(time_t wall, uint32_t now_ms) {
+    if (this->source_ == ClockSource::SYNCED || wall < this->floor_) return;
+    this->anchor_ = wall;
+    this->anchor_ms_ = now_ms;
+    this->source_ = ClockSource::RESUMED;
+  }
+
+  // Earliest time a source may report
+  void set_floor(time_t floor) { this->floor_ = floor; }
+
+ protected:
+  time_t anchor_ = 0;
+  uint32_t anchor_ms_ = 0;
+  time_t floor_ = 0;
+  ClockSource source_ = ClockSource::NONE;
+};
+
+// The shelf clock's time in RTC memory. Declare it RTC_NOINIT_ATTR (see
+// cycle_checkpoint.h). The time is saved with the tick it was saved on, since
+// with a stretched tick (low-power idle) it can be that far behind when a
+// reset comes; each field is checked against the others, so a torn write or
+// power-on garbage reads as no time.
+class ClockCheckpoint {
+ public:
+  // Longest tick a saved time is trusted for
+  static const uint32_t MAX_BEHIND_S = 5;
+
+  void save(time_t wall, uint32_t tick_s) {
+    this->key_ = KEY;
+    this->tick_s_ = tick_s;
+    this->wall_ = (int64_t) wall;
+    this->check_ = ~((uint64_t) this->wall_ ^ tick_s);
+  }
+
+  // The saved time, or 0 if there is none or it may be too far behind
+  time_t restore() const {
+    if (this->key_ != KEY || this->check_ != ~((uint64_t) this->wall_ ^ this->tick_s_)) return 0;
+    return this->tick_s_ <= MAX_BEHIND_S ? (time_t) this->wall_ : 0;
+  }
+
+  void clear() { this->key_ = 0; }
+
+ protected:
+  static const uint32_t KEY = 0x464C434B;
+
+  uint32_t key_;
+  uint32_t tick_s_;
+  int64_t wall_;
+  uint64_t check_;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "pump_state.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Aggregated shelf state
+//
+// One text entity carries what Home Assistant otherwise reads from a status,
+// countdown, depth and distance entity per bin, as compact JSON:
+//
+//   {"p":"FSII","d":[42,null,null,null],"n":[0,1760680800,1760680800,null]}
+//
+// p is one letter per bin (Idle, Filling, Soaking, Draining, fault X), d the
+// water depth in whole mm and n the next scheduled start as a Unix time (0
+// while the bin is due and waiting its turn); null where a bin has no depth
+// sensor or no start planned. Next starts are absolute, so they only change
+// when a schedule does, where a countdown changes every minute. Setters only
+// record a change; the caller publishes format() once per batch of changes,
+// so the entity updates atomically and at most once per batch.
+
+template<size_t N> class ShelfState {
+ public:
+  // Room for every field at its widest; 8 bins stay under Home Assistant's
+  // 255-character state limit
+  static const size_t TEXT_SIZE = 24 + N * 18;
+  static const int32_t NONE = INT32_MIN;
+
+  ShelfState() {
+    for (size_t i = 0; i < N; i++) {
+      this->phases_[i] = PumpPhase::IDLE;
+      this->depths_[i] = NONE;
+      this->next_fire_[i] = NONE;
+    }
+  }
+
+  // Setters return true if the state changed
+  bool set_phase(int bin_num, PumpPhase phase) {
+    return bin_num >= 1 && bin_num <= (int) N && this->update(this->phases_[bin_num - 1], phase);
+  }
+
+  // Depth in mm, rounded to whole mm so sensor noise doesn't republish; NAN
+  // for no reading
+  bool set_depth(int bin_num, float depth) {
+    int32_t mm = std::isnan(depth) ? NONE : (int32_t) lroundf(depth);
+    return bin_num >= 1 && bin_num <= (int) N && this->update(this->depths_[bin_num - 1], mm);
+  }
+
+  // Next start as a Unix time, 0 for due now, NONE for nothing planned
+  bool set_next_fire(int bin_num, int32_t timestamp) {
+    return bin_num >= 1 && bin_num <= (int) N && this->update(this->next_fire_[bin_num - 1], timestamp);
+  }
+
+  // Changed since the last format()
+  bool dirty() const { return this->dirty_; }
+
+  // The state as JSON, and clear the change flag. Returns a buffer owned by
+  // this object, overwritten by the next call.
+  const char *format() {
+    static const char PHASE_LETTERS[] = "IFS?D???X";
+    size_t length = snprintf(this->text_, TEXT_SIZE, "{\"p\":\"");
+    for (size_t i = 0; i < N && length < TEXT_SIZE; i++) {
+      uint8_t phase = (uint8_t) this->phases_[i];
+      this->text_[length++] = phase < sizeof(PHASE_LETTERS) - 1 ? PHASE_LETTERS[phase] : '?';
+    }
+    length += snprintf(this->text_ + length, TEXT_SIZE - length, "\",\"d\":");
+    length = this->append_list(length, this->depths_);
+    length += snprintf(this->text_ + length, TEXT_SIZE - length, ",\"n\":");
+    length = this->append_list(length, this->next_fire_);
+    snprintf(this->text_ + length, TEXT_SIZE - length, "}");
+    this->dirty_ = false;
+    return this->text_;
+  }
+
+ protected:
+  template<typename T> bool update(T &field, T value) {
+    if (field == value) return false;
+    field = value;
+    this->dirty_ = true;
+    return true;
+  }
+
+  size_t append_list(size_t length, const int32_t (&values)[N]) {
+    for (size_t i = 0; i < N && length < TEXT_SIZE; i++) {
+      const char *separator = i == 0 ? "[" : ",";
+      if (values[i] == NONE) {
+        length += snprintf(this->text_ + length, TEXT_SIZE - length, "%snull", separator);
+      } else {
+        length += snprintf(this->text_ + length, TEXT_SIZE - length, "%s%ld", separator, (long) values[i]);
+      }
+    }
+    if (length < TEXT_SIZE) length += snprintf(this->text_ + length, TEXT_SIZE - length, "]");
+    return length < TEXT_SIZE ? length : TEXT_SIZE - 1;
+  }
+
+  PumpPhase phases_[N];
+  int32_t depths_[N];
+  int32_t next_fire_[N];
+  bool dirty_ = true;
+  char text_[TEXT_SIZE];
+};
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Hierarchical timer wheel
+//
+// Holds a fixed set of TIMERS one-shot timers, each identified by its index,
+// at one-second resolution. Three levels of 64 slots cover 64 s, ~68 min and
+// ~3 days; a timer further out waits in the top level and is re-filed each
+// time that slot comes round. Advancing by a tick touches one level-0 slot
+// and, every 64 ticks, re-files one higher-level slot, so the cost per tick
+// doesn't depend on how many timers are armed. Timers live in a fixed array
+// linked by index; nothing allocates.
+template<size_t TIMERS> class TimerWheel {
+  static_assert(TIMERS >= 1 && TIMERS < 255, "TimerWheel holds 1 to 254 timers");
+
+ public:
+  using Callback = void (*)(int arg);
+
+  TimerWheel() {
+    for (size_t i = 0; i < LEVELS * SLOTS; i++) this->heads_[i] = NONE;
+  }
+
+  // Current tick (seconds since the wheel started)
+  uint32_t now() const { return this->now_; }
+
+  // (Re)arm timer id to call callback(arg) delay_s ticks from now
+  void arm(size_t id, uint32_t delay_s, Callback callback, int arg) {
+    if (id >= TIMERS) return;
+    this->cancel(id);
+    Timer &timer = this->timers_[id];
+    timer.deadline = this->now_ + (delay_s == 0 ? 1 : delay_s);
+    timer.callback = callback;
+    timer.arg = arg;
+    this->file(id);
+  }
+
+  void cancel(size_t id) {
+    if (id >= TIMERS || this->timers_[id].slot == NONE) return;
+    this->unlink(id);
+  }
+
+  bool armed(size_t id) const { return id < TIMERS && this->timers_[id].slot != NONE; }
+
+  // Ticks until timer id fires (0 if not armed)
+  uint32_t remaining(size_t id) const { return this->armed(id) ? this->timers_[id].deadline - this->now_ : 0; }
+
+  // Ticks until the first armed timer fires (0 if none is armed); scans
+  // every timer, so call it once per tick at most
+  uint32_t next_due() const {
+    uint32_t first = 0;
+    for (size_t id = 0; id < TIMERS; id++) {
+      uint32_t left = this->remaining(id);
+      if (this->armed(id) && (first == 0 || left < first)) first = left;
+    }
+    return first;
+  }
+
+  // Advance tick by tick to now_s, firing every timer whose deadline arrives
+  void advance_to(uint32_t now_s) {
+    while ((int32_t)(now_s - this->now_) > 0) {
+      this->now_++;
+      if ((this->now_ & (SLOTS - 1)) == 0) {
+        this->refile(1, (this->now_ >> BITS) & (SLOTS - 1));
+        if (((this->now_ >> BITS) & (SLOTS - 1)) == 0) this->refile(2, (this->now_ >> (2 * BITS)) & (SLOTS - 1));
+      }
+      size_t slot = this->now_ & (SLOTS - 1);
+      while (this->heads_[slot] != NONE) {
+        uint8_t id = this->heads_[slot];
+        this->unlink(id);
+        Timer &timer = this->timers_[id];
+        if (timer.deadline != this->now_) {
+          this->file(id);  // a lap early: not due yet
+          continue;
+        }
+        timer.callback(timer.arg);
+      }
+    }
+  }
+
+ protected:
+  static const uint8_t NONE = 255;
+  static const int BITS = 6;
+  static const size_t SLOTS = 1 << BITS;
+  static const size_t LEVELS = 3;
+
+  struct Timer {
+    uint32_t deadline = 0;
+    Callback callback = nullptr;
+    int arg = 0;
+    uint8_t slot = NONE;  // index into heads_, NONE when not armed
+    uint8_t prev = NONE;
+    uint8_t next = NONE;
+  };
+
+  // Put a timer in the slot its deadline falls in, seen from the current tick
+  void file(uint8_t id) {
+    Timer &timer = this->timers_[id];
+    uint32_t delta = timer.deadline - this->now_;
+    size_t index;
+    if (delta < SLOTS) {
+      index = timer.deadline & (SLOTS - 1);
+    } else if (delta < SLOTS * SLOTS) {
+      index = SLOTS + ((timer.deadline >> BITS) & (SLOTS - 1));
+    } else if (delta < SLOTS * SLOTS * SLOTS) {
+      index = 2 * SLOTS + ((timer.deadline >> (2 * BITS)) & (SLOTS - 1));
+    } else {
+      // Beyond the wheel: park in the top-level slot just behind the current one
+      index = 2 * SLOTS + (((this->now_ >> (2 * BITS)) - 1) & (SLOTS - 1));
+    }
+    timer.slot = index;
+    timer.prev = NONE;
+    timer.next = this->heads_[index];
+    if (timer.next != NONE) this->timers_[timer.next].prev = id;
+    this->heads_[index] = id;
+  }
+
+  void unlink(uint8_t id) {
+    Timer &timer = this->timers_[id];
+    if (timer.prev != NONE) {
+      this->timers_[timer.prev].next = timer.next;
+    } else {
+      this->heads_[timer.slot] = timer.next;
+    }
+    if (timer.next != NONE) this->timers_[timer.next].prev = timer.prev;
+    timer.slot = NONE;
+  }
+
+  // Move every timer of a higher-level slot down to where it now belongs
+  void refile(size_t level, size_t slot) {
+    size_t index = level * SLOTS + slot;
+    uint8_t id = this->heads_[index];
+    this->heads_[index] = NONE;
+    while (id != NONE) {
+      uint8_t next = this->timers_[id].next;
+      this->file(id);
+      id = next;
+    }
+  }
+
+  Timer timers_[TIMERS];
+  uint8_t heads_[LEVELS * SLOTS];
+  uint32_t now_ = 0;
+};
@@ -0,0 +1,119 @@
+// Empty distance calibration through weeks of idle readings
+//
+// Feeds EmptyCalibrator the way on_distance_sample() does: 5 s idle samples
+// with ToF noise between cycles, drained() when a drain reaches empty, wet()
+// as a cycle starts, and the empty distance moved whenever it proposes. The
+// tray's true empty distance drifts; the baseline must follow it in a few
+// hysteresis steps, and never move on noise, water, a timed-out drain, a
+// dripping tray or something over the sensor.
+
+#include "empty_calibrator.h"
+
+#include <cmath>
+#include <cstdio>
+
+static const uint32_t SAMPLE_MS = 5000;  // DEPTH_SLOW_INTERVAL_MS
+static const uint32_t CYCLE_MS = 2 * 3600 * 1000;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+  printf("%-58s %s\n", what, ok ? "ok" : "FAIL");
+  if (!ok) failures++;
+}
+
+// Deterministic noise, roughly normal with the given deviation
+static uint32_t noise_state = 12345;
+static float noise(float deviation) {
+  float sum = 0;
+  for (int i = 0; i < 4; i++) {
+    noise_state = noise_state * 1664525u + 1013904223u;
+    sum += (noise_state >> 8) / 16777216.0f - 0.5f;
+  }
+  return sum * deviation * 1.732f;
+}
+
+// A bin on the strawberry shelf: one cycle every few days, the empty
+// distance as the number entity holds it
+struct Bin {
+  EmptyCalibrator calibrator;
+  float empty_distance = 200;
+  uint32_t ms = 0;
+  int moves = 0;
+  float largest_error = 0;  // baseline against the true empty distance, once settled
+
+  void sample(float distance) {
+    this->ms += SAMPLE_MS;
+    if (!this->calibrator.add_sample(this->ms, distance, this->empty_distance)) return;
+    float moved;
+    if (this->calibrator.propose(moved)) {
+      this->empty_distance = moved;
+      this->calibrator.moved(moved);
+      this->moves++;
+    }
+  }
+
+  // A cycle whose drain reaches empty (or levels off or times out), then idle
+  // for hours; the tray drips for a few minutes after the drain
+  template<typename Empty> void cycle(bool drained, float hours, Empty true_empty) {
+    this->calibrator.wet();
+    this->ms += CYCLE_MS;
+    if (drained) this->calibrator.drained(this->ms);
+    uint32_t idle_ms = (uint32_t)(hours * 3600000);
+    for (uint32_t t = 0; t < idle_ms; t += SAMPLE_MS) {
+      float dripping = t < 300000 ? 4.0f * (1 - t / 300000.0f) : 0;
+      float empty = true_empty(this->ms);
+      this->sample(empty - dripping + noise(1.0f));
+      if (t > 12 * 3600000u) this->largest_error = fmaxf(this->largest_error, fabsf(this->empty_distance - empty));
+    }
+  }
+};
+
+int main() {
+  // The hand-set value is right: noise never moves it
+  Bin steady;
+  for (int i = 0; i < 6; i++) steady.cycle(true, 5 * 24, [](uint32_t) { return 200.4f; });
+  check(steady.moves == 0, "calibrated baseline left alone");
+  check(steady.calibrator.confidence() >= 0.9f, "confidence full after a dry day");
+
+  // Set 6 mm out by hand: corrected once, within the hysteresis
+  Bin off;
+  for (int i = 0; i < 2; i++) off.cycle(true, 5 * 24, [](uint32_t) { return 206.0f; });
+  check(off.moves == 1 && fabsf(off.empty_distance - 206) < EmptyCalibrator::HYSTERESIS_MM,
+        "baseline set 6 mm out corrected in one step");
+
+  // Condensation creeping 5 mm over a month
+  Bin drifting;
+  for (int i = 0; i < 6; i++) {
+    drifting.cycle(true, 5 * 24, [](uint32_t ms) { return 200 - 5.0f * ms / (30.0f * 86400000); });
+  }
+  check(drifting.moves >= 2 && drifting.moves <= 4, "month of drift followed in a few steps");
+  check(drifting.largest_error <= EmptyCalibrator::HYSTERESIS_MM + 0.5f, "baseline within hysteresis of the drift");
+
+  // Drains that time out leave the tray unverified: nothing learned
+  Bin timed_out;
+  for (int i = 0; i < 4; i++) timed_out.cycle(false, 5 * 24, [](uint32_t) { return 206.0f; });
+  check(timed_out.moves == 0 && timed_out.calibrator.confidence() == 0, "timed-out drains teach nothing");
+
+  // Water left in the tray, or a leaf on the sensor: sessions thrown away
+  Bin blocked;
+  for (int i = 0; i < 2; i++) blocked.cycle(true, 5 * 24, [](uint32_t) { return 185.0f; });
+  check(blocked.moves == 0 && blocked.calibrator.confidence() == 0, "readings far off the baseline ignored");
+
+  // A cycle starting mid-session: no move until idle again, and samples fed
+  // while wet (as if a cycle ran) are never counted
+  Bin cut;
+  cut.cycle(true, 0.5f, [](uint32_t) { return 206.0f; });
+  cut.calibrator.wet();
+  float before = cut.calibrator.confidence();
+  for (int i = 0; i < 20000; i++) cut.sample(206 + noise(1.0f));
+  check(cut.moves == 0 && cut.calibrator.confidence() == before, "nothing learned or moved during a cycle");
+
+  // A hand calibration restarts the statistics from it
+  steady.empty_distance = 190;
+  steady.sample(200.4f);
+  check(steady.calibrator.confidence() == 0 && steady.empty_distance == 190, "hand-set baseline restarts calibration");
+
+  printf("calibrator state %u bytes per bin\n", (unsigned) sizeof(EmptyCalibrator));
+  return failures == 0 ? 0 : 1;
+}
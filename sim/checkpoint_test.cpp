@@ -0,0 +1,128 @@
+// Flood cycle checkpoints across a reset
+//
+// Checks CycleCheckpoint on its own (memory left random by power-on, time
+// left from the saved tick, writes torn by a reset), then boots the real
+// helpers over the checkpoint an interrupted previous boot left behind and
+// follows the resumed cycles: a fill picks up with its time left, a soak
+// that keeps failing skips to the drain, a drain that keeps failing stops in
+// Fault, and an overdue step ends on the first tick. The bin left in Fault
+// is then missed once, isn't queued day after day, and doesn't keep the
+// shelf out of low-power idle.
+
+#include "sim_shelf.h"
+#include "flood_helpers.h"
+
+#include <cstdio>
+#include <cstring>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+  printf("%-58s %s\n", what, ok ? "ok" : "FAIL");
+  if (!ok) failures++;
+}
+
+// Reaches into the record to tear writes the way a reset would
+struct TornCheckpoint : CycleCheckpoint<4> {
+  void tear_tick(uint32_t tick) { this->tick_ = tick; }  // new tick, old complement
+  void tear_entry(int bin_num) { this->entries_[bin_num - 1].deadline ^= 0x10; }
+};
+
+static void check_record() {
+  CycleCheckpoint<4>::Saved saved[4];
+
+  TornCheckpoint checkpoint;
+  memset(static_cast<void *>(&checkpoint), 0xA5, sizeof(checkpoint));
+  check(!checkpoint.restore(saved) && saved[0].step == CycleCheckpoint<4>::IDLE, "power-on garbage is no checkpoint");
+
+  checkpoint.reset();
+  checkpoint.set_tick(100);
+  checkpoint.save(1, CYCLE_SOAK, 400, 0);
+  checkpoint.save(3, CYCLE_FILL, 200, 1);
+  checkpoint.set_tick(250);
+  bool valid = checkpoint.restore(saved);
+  check(valid && saved[0].step == CYCLE_SOAK && saved[0].remaining_s == 150 && saved[1].step == CycleCheckpoint<4>::IDLE,
+        "time left from the last tick");
+  check(saved[2].step == CYCLE_FILL && saved[2].remaining_s == 0 && saved[2].resumes == 1, "overdue step, resume count");
+
+  checkpoint.tear_tick(251);
+  check(checkpoint.restore(saved) && saved[0].remaining_s == 150, "torn tick counts from the earlier one");
+
+  checkpoint.set_tick(250);
+  checkpoint.tear_entry(1);
+  check(checkpoint.restore(saved) && saved[0].step == CycleCheckpoint<4>::IDLE && saved[2].step == CYCLE_FILL,
+        "torn entry loses only its own bin");
+}
+
+static void tick_to(uint32_t s) {
+  while (millis() / 1000 < s) {
+    sim_clock::set(sim_clock::now_ms + 1000);
+    service_timers();
+  }
+}
+
+static bool bin_is(int bin_num, PumpPhase phase, bool pump, bool reverse) {
+  const SimBinIds &ids = sim_bin_ids[bin_num - 1];
+  return get_pump_phase(bin_num) == phase && ids.pump->state == pump && ids.reverse->state == reverse;
+}
+
+static void check_resume() {
+  for (int bin_num = 1; bin_num <= SIM_BIN_COUNT; bin_num++) sim_bin_ids[bin_num - 1].enable->publish_state(true);
+
+  // What the previous boot left: bin 1 filling with 120 s to go, bin 2's
+  // soak and bin 3's drain already resumed twice, bin 4's drain overdue
+  cycle_checkpoint.reset();
+  cycle_checkpoint.set_tick(5000);
+  cycle_checkpoint.save(1, CYCLE_FILL, 5120, 0);
+  cycle_checkpoint.save(2, CYCLE_SOAK, 6000, CYCLE_MAX_RESUMES);
+  cycle_checkpoint.save(3, CYCLE_DRAIN, 5300, CYCLE_MAX_RESUMES);
+  cycle_checkpoint.save(4, CYCLE_DRAIN, 4990, 0);
+
+  sim_clock::set(0);
+  resume_flood_cycles();
+  check(bin_is(1, PumpPhase::FILLING, true, true), "fill resumed, pump on in reverse");
+  check(bin_is(2, PumpPhase::DRAINING, true, false), "soak interrupted too often skips to the drain");
+  check(bin_is(3, PumpPhase::FAULT, false, false), "drain interrupted too often stops in Fault");
+  check(bin_is(4, PumpPhase::DRAINING, true, false), "overdue drain resumed");
+
+  CycleCheckpoint<SIM_BIN_COUNT>::Saved saved[SIM_BIN_COUNT];
+  check(cycle_checkpoint.restore(saved) && saved[0].step == CYCLE_FILL && saved[0].remaining_s == 120 &&
+            saved[0].resumes == 1 && saved[1].remaining_s == 600 && saved[1].resumes == 0 &&
+            saved[2].step == CycleCheckpoint<SIM_BIN_COUNT>::IDLE,
+        "checkpoint rewritten for this boot");
+
+  tick_to(1);
+  check(bin_is(4, PumpPhase::IDLE, false, false), "overdue drain ends on the first tick");
+  tick_to(119);
+  check(bin_is(1, PumpPhase::FILLING, true, true), "fill runs its time left...");
+  tick_to(120);
+  check(bin_is(1, PumpPhase::SOAKING, false, true), "...and no longer");
+  tick_to(600);
+  check(bin_is(2, PumpPhase::IDLE, false, false), "skipped-to drain runs its full length");
+  tick_to(120 + 30 * 60 + 10 * 60);
+  check(bin_is(1, PumpPhase::IDLE, false, false), "resumed cycle completes");
+}
+
+// Bin 3 is in Fault; the others are idle and disabled
+static void check_fault() {
+  for (int bin_num = 1; bin_num <= SIM_BIN_COUNT; bin_num++) {
+    sim_bin_ids[bin_num - 1].enable->publish_state(bin_num == 3);
+  }
+  time_t window = 1767258000;  // 2026-01-01 09:00 UTC
+  open_watering_window(window);
+  open_watering_window(window + 86400);
+  check(get_pump_phase(3) == PumpPhase::FAULT && !is_watering_queued(), "bin in Fault not queued");
+  check(get_missed_watering_windows() == 1, "bin in Fault missed once");
+
+  sim_clock::set((int64_t)(window + 86400 + 60) * 1000);
+  low_power_idle->publish_state(true);
+  tick_to(millis() / 1000 + 5);
+  check(flood_tick->update_interval > FLOOD_TICK_MS, "bin in Fault leaves low-power idle on");
+}
+
+int main() {
+  check_record();
+  check_resume();
+  check_fault();
+  return failures == 0 ? 0 : 1;
+}
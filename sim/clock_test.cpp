@@ -0,0 +1,160 @@
+// Shelf clock through resets and time source outages
+//
+// Checks ShelfClock and ClockCheckpoint on their own (millis() wrapping,
+// sources behind the last known time, power-on garbage, a stretched tick),
+// then boots the real helpers with Home Assistant down: after a reset the
+// shelf schedules from its first tick and waters on time through a day
+// without a source; after a power cut it waits until SNTP syncs. Last, a
+// wrong time in the journal: every source is rejected until SNTP, which
+// resets the floor and the schedule. And the interval count across a leap
+// year's end.
+
+#include "sim_shelf.h"
+#include "flood_helpers.h"
+
+#include <cstdio>
+#include <cstring>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+  printf("%-58s %s\n", what, ok ? "ok" : "FAIL");
+  if (!ok) failures++;
+}
+
+static const time_t DAY_START = 1767225600;  // 2026-01-01 00:00 UTC
+static const time_t WATERING = DAY_START + 8 * 3600;
+
+static void check_clock() {
+  ShelfClock clock;
+  check(!clock.valid() && clock.now(1000) == 0, "no time before a source");
+
+  clock.sync(DAY_START, 0xFFFFF000u);
+  check(clock.now(0x00001000u) == DAY_START + 8, "runs on across millis() wrapping");
+  check(clock.sync(DAY_START + 14, 0x00002000u) == 2, "sync reports its step");
+
+  clock.set_floor(DAY_START + 100);
+  check(clock.sync(DAY_START + 50, 0x00003000u) == ShelfClock::NO_STEP && clock.now(0x00003000u) == DAY_START + 18,
+        "source behind the floor rejected");
+
+  clock.resume(DAY_START + 500, 0x00004000u);
+  check(clock.source() == ClockSource::SYNCED && clock.now(0x00004000u) == DAY_START + 22,
+        "saved time ignored once synced");
+
+  clock.set_floor(DAY_START + 86400);
+  check(clock.trust(DAY_START + 30, 0x00005000u) == 4 && clock.now(0x00005000u) == DAY_START + 30 &&
+            clock.sync(DAY_START + 31, 0x00006000u) == -3,
+        "trusted source lowers the floor");
+
+  ClockCheckpoint checkpoint;
+  memset(static_cast<void *>(&checkpoint), 0xA5, sizeof(checkpoint));
+  check(checkpoint.restore() == 0, "power-on garbage is no time");
+  checkpoint.save(WATERING, 1);
+  check(checkpoint.restore() == WATERING, "saved time read back");
+  checkpoint.save(WATERING, 3600);
+  check(checkpoint.restore() == 0, "time saved on a stretched tick not trusted");
+}
+
+static void tick_for(uint32_t seconds) {
+  for (uint32_t i = 0; i < seconds; i++) {
+    sim_clock::set(sim_clock::now_ms + 1000);
+    service_timers();
+  }
+}
+
+// A boot with no time source, wall time running on: a new timer wheel, and
+// RTC memory kept or, after a power cut, lost
+static void reboot(bool power_cut) {
+  sim_clock::reboot();
+  homeassistant_time->synced = false;
+  shelf_clock = ShelfClock();
+  flood_timers = decltype(flood_timers)();
+  if (power_cut) memset(static_cast<void *>(&clock_checkpoint), 0, sizeof(clock_checkpoint));
+  restore_schedule_journal();
+  restore_shelf_clock();
+  start_bin_schedules();
+}
+
+static void check_outage() {
+  sim_bin_ids[0].enable->publish_state(true);
+  sim_bin_ids[0].cycle_interval->publish_state(1);
+  sim_bin_ids[0].interval_time->value() = 8;
+
+  // Previous boot: synced, the clock saved each tick
+  sim_clock::set((int64_t)(WATERING - 3600) * 1000);
+  tick_for(5);
+
+  reboot(false);
+  ESPTime now = shelf_now();
+  check(now.is_valid() && now.timestamp == WATERING - 3600 + 5, "reset: clock resumed at boot");
+  tick_for(1);
+  check(get_next_fire_time(1, shelf_now()) == WATERING, "reset: next start planned on the first tick");
+  tick_for(3600 - 7);
+  check(get_pump_phase(1) == PumpPhase::IDLE, "reset: idle before the watering hour");
+  tick_for(2);
+  check(get_pump_phase(1) == PumpPhase::FILLING && get_last_cycle(1) == WATERING,
+        "reset: waters on time without a source");
+  tick_for(86400 + 2 * 3600);
+  check(get_last_cycle(1) == WATERING + 86400 && get_pump_phase(1) == PumpPhase::IDLE,
+        "reset: waters again a day later");
+
+  // Power cut just before the next watering hour
+  sim_clock::set((int64_t)(WATERING + 2 * 86400 - 60) * 1000);
+  reboot(true);
+  check(!shelf_now().is_valid(), "power cut: no time without a source");
+  tick_for(600);
+  check(get_pump_phase(1) == PumpPhase::IDLE && get_last_cycle(1) == WATERING + 86400,
+        "power cut: no watering on a guessed time");
+
+  // An RTC chip with a flat battery reports last year
+  homeassistant_time->synced = true;
+  sim_clock::now_ms -= (int64_t) 365 * 86400 * 1000;
+  check(!shelf_now().is_valid(), "source behind the last cycle start rejected");
+  sim_clock::now_ms += (int64_t) 365 * 86400 * 1000;
+
+  // SNTP syncs
+  tick_for(1);
+  check(shelf_clock.source() == ClockSource::SYNCED && shelf_now().timestamp == sim_clock::seconds(),
+        "power cut: clock follows the first good source");
+}
+
+// A wrong time once reached the journal: a cycle start a year ahead
+static void check_poisoned_journal() {
+  time_t watering = WATERING + 4 * 86400;
+  sim_clock::set((int64_t)(watering - 3600) * 1000);
+  tick_for(1);
+  set_last_cycle(1, (int) (watering + 365 * 86400));
+  note_schedule_change();
+  tick_for(600);
+
+  reboot(true);
+  homeassistant_time->synced = true;
+  tick_for(1);
+  check(!shelf_now().is_valid(), "journal ahead: Home Assistant rejected");
+
+  sntp_time->synced = true;
+  on_trusted_time_sync();
+  check(shelf_now().timestamp == sim_clock::seconds() && get_last_cycle(1) == sim_clock::seconds(),
+        "journal ahead: SNTP accepted, cycle start pulled back");
+  tick_for(3600);
+  check(get_last_cycle(1) == watering, "journal ahead: waters at the next watering hour");
+}
+
+// Days since the last run, counted in day-of-year across New Year
+static void check_year_end() {
+  bins.set(1, &BinRefs::last_run_day, 366);
+  ESPTime new_year = ESPTime::from_epoch_local(1735732800);  // 2025-01-01 12:00 UTC
+  check(get_days_since_last_run(1, new_year) == 1, "days since a run on a leap year's last day");
+  bins.set(1, &BinRefs::last_run_day, 364);
+  ESPTime jan_2 = ESPTime::from_epoch_local(1767355200);  // 2026-01-02 12:00 UTC
+  check(get_days_since_last_run(1, jan_2) == 3, "days since a run late in a common year");
+  bins.set(1, &BinRefs::last_run_day, 0);
+}
+
+int main() {
+  check_clock();
+  check_year_end();
+  check_outage();
+  check_poisoned_journal();
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+// Drains through the plateau detector
+//
+// Synthetic drains at 20 Hz with ToF noise: the level falls, slows as the
+// tray empties and levels off where the sensor's calibration puts empty.
+// With the default settings (1.5 mm/min over 15 s, 2 mm fall first), every
+// drain must be called done after its flow slows under that rate, and within
+// DETECT_S of it, whether the pump primes first or the tail is slow. Each
+// drain runs with several noise seeds, since one lucky seed proves little.
+
+#include "drain_plateau.h"
+
+#include <cmath>
+#include <cstdio>
+
+static const size_t WINDOW_S = 15;              // get_drain_plateau_window_s() default
+static const float RATE_MM_S = 1.5f / 60.0f;    // get_drain_plateau_rate() default
+static const float MIN_FALL_MM = 2.0f;          // DRAIN_MIN_FALL_MM in flood_helpers.h
+static const uint32_t SAMPLE_MS = 50;           // DEPTH_FAST_INTERVAL_MS
+static const float DETECT_S = 35;
+
+struct Drain {
+  const char *name;
+  float start_mm;   // depth at the start
+  float flat_mm;    // where the level ends up: empty, off by the calibration
+  float prime_s;    // pump filling its tubing before the level moves
+  float rate_mm_s;  // fall rate while the tray is full
+  float tail_s;     // time constant of the slowdown as it empties
+  float noise_mm;
+};
+
+// Depth at t, and the time the fall rate drops under the plateau rate
+static float drain_depth(const Drain &drain, float t) {
+  if (t < drain.prime_s) return drain.start_mm;
+  float above = drain.start_mm - drain.flat_mm;
+  float linear_s = (above - drain.rate_mm_s * drain.tail_s) / drain.rate_mm_s;
+  t -= drain.prime_s;
+  if (t < linear_s) return drain.start_mm - drain.rate_mm_s * t;
+  return drain.flat_mm + drain.rate_mm_s * drain.tail_s * expf(-(t - linear_s) / drain.tail_s);
+}
+
+static float flow_end_s(const Drain &drain) {
+  float above = drain.start_mm - drain.flat_mm;
+  float linear_s = (above - drain.rate_mm_s * drain.tail_s) / drain.rate_mm_s;
+  return drain.prime_s + linear_s + drain.tail_s * logf(drain.rate_mm_s / RATE_MM_S);
+}
+
+// Deterministic noise, roughly normal with the given deviation
+static uint32_t noise_state = 12345;
+static float noise(float deviation) {
+  float sum = 0;
+  for (int i = 0; i < 4; i++) {
+    noise_state = noise_state * 1664525u + 1013904223u;
+    sum += (noise_state >> 8) / 16777216.0f - 0.5f;
+  }
+  return sum * deviation * 1.732f;
+}
+
+static bool run_drain(const Drain &drain, uint32_t seed) {
+  noise_state = seed;
+  DrainPlateau plateau;
+  plateau.reset();
+  float end_s = flow_end_s(drain);
+  float done_s = -1;
+  for (uint32_t ms = 0; ms < 1800000; ms += SAMPLE_MS) {
+    float t = ms / 1000.0f;
+    plateau.add_sample(1000000 + ms, drain_depth(drain, t) + noise(drain.noise_mm));
+    if (plateau.plateaued(WINDOW_S, RATE_MM_S, MIN_FALL_MM)) {
+      done_s = t;
+      break;
+    }
+  }
+  bool ok = done_s >= end_s && done_s <= end_s + DETECT_S;
+  printf("%-26s seed %-6u flow slows %6.1f s, done at %6.1f s  %s\n", drain.name, (unsigned) seed, end_s, done_s,
+         ok ? "ok" : "FAIL");
+  return ok;
+}
+
+int main() {
+  static const Drain DRAINS[] = {
+      {"calibrated", 50, 0, 0, 0.3f, 20, 0.5f},
+      {"empty reads 8 mm", 50, 8, 0, 0.3f, 20, 0.5f},
+      {"empty reads -6 mm", 50, -6, 0, 0.3f, 20, 0.5f},
+      {"10 s priming", 50, 8, 10, 0.3f, 20, 0.5f},
+      {"slow pump, long tail", 30, 6, 5, 0.08f, 90, 0.5f},
+      {"noisy sensor", 50, 8, 3, 0.3f, 20, 1.0f},
+  };
+  static const uint32_t SEEDS[] = {12345, 7, 2024, 31337};
+  bool ok = true;
+  for (const Drain &drain : DRAINS) {
+    for (uint32_t seed : SEEDS) ok = run_drain(drain, seed) && ok;
+  }
+
+  // A tray that never drains (blocked outlet) is never called done; the
+  // drain's timeout ends it
+  DrainPlateau blocked;
+  blocked.reset();
+  bool called = false;
+  for (uint32_t ms = 0; ms < 600000; ms += SAMPLE_MS) {
+    blocked.add_sample(ms, 50 + noise(0.5f));
+    called = called || blocked.plateaued(WINDOW_S, RATE_MM_S, MIN_FALL_MM);
+  }
+  printf("%-26s %s\n", "blocked outlet never done", called ? "FAIL" : "ok");
+  return ok && !called ? 0 : 1;
+}
@@ -0,0 +1,307 @@
+#pragma once
+
+// Host stand-in for ESPHome's esphome.h
+//
+// Just enough of the ESPHome API for the headers in esphome/ to compile and
+// run on Linux: entities with a public state, globals, switch actions that
+// call back into the simulator, and a virtual clock behind millis() and
+// id(homeassistant_time).now().
+
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace esphome {
+
+// Virtual clock, advanced only by the simulator; millis() counts from the
+// last simulated boot
+namespace sim_clock {
+inline int64_t now_ms = 0;
+inline int64_t boot_ms = 0;
+inline void set(int64_t ms) { now_ms = ms; }
+inline void reboot() { boot_ms = now_ms; }
+inline time_t seconds() { return (time_t)(now_ms / 1000); }
+}  // namespace sim_clock
+
+inline uint32_t millis() { return (uint32_t)(sim_clock::now_ms - sim_clock::boot_ms); }
+
+// Execution timing runs on the host's real clock, not the virtual one
+inline uint32_t micros() {
+  return (uint32_t) std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+inline void delayMicroseconds(uint32_t us) { (void) us; }
+
+// Log level: 0 = off, 1 = warnings, 2 = info, 3 = debug
+inline int sim_log_level = 1;
+
+inline void sim_log(int level, const char *tag, const char *format, ...) {
+  if (level > sim_log_level) return;
+  time_t now = sim_clock::seconds();
+  struct tm tm;
+  gmtime_r(&now, &tm);
+  fprintf(stderr, "%04d-%02d-%02d %02d:%02d:%02d [%s] ", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
+          tm.tm_min, tm.tm_sec, tag);
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+#define ESP_LOGE(tag, ...) esphome::sim_log(1, tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) esphome::sim_log(1, tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) esphome::sim_log(2, tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) esphome::sim_log(3, tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) esphome::sim_log(4, tag, __VA_ARGS__)
+
+// Same shape as ESPHome's id(): entities are pointers, id() dereferences
+template<typename T> T &id(T *value) { return *value; }
+
+struct ESPTime {
+  uint8_t second;
+  uint8_t minute;
+  uint8_t hour;
+  uint8_t day_of_week;
+  uint8_t day_of_month;
+  uint16_t day_of_year;
+  uint8_t month;
+  uint16_t year;
+  bool is_dst;
+  time_t timestamp;
+
+  bool is_valid() const { return this->year >= 2019; }
+
+  // The simulator runs in UTC
+  static ESPTime from_epoch_local(time_t epoch) {
+    struct tm tm;
+    gmtime_r(&epoch, &tm);
+    ESPTime out;
+    out.second = tm.tm_sec;
+    out.minute = tm.tm_min;
+    out.hour = tm.tm_hour;
+    out.day_of_week = tm.tm_wday + 1;
+    out.day_of_month = tm.tm_mday;
+    out.day_of_year = tm.tm_yday + 1;
+    out.month = tm.tm_mon + 1;
+    out.year = tm.tm_year + 1900;
+    out.is_dst = false;
+    out.timestamp = epoch;
+    return out;
+  }
+};
+
+namespace time {
+// Invalid until synced, like a time source before its first sync
+class RealTimeClock {
+ public:
+  bool synced{true};
+  ESPTime now() { return ESPTime::from_epoch_local(this->synced ? sim_clock::seconds() : 0); }
+};
+}  // namespace time
+
+// Preferences held in memory; writes counts every slot committed to "flash"
+class ESPPreferenceObject {
+ public:
+  ESPPreferenceObject() = default;
+  ESPPreferenceObject(std::vector<uint8_t> *data, uint32_t *writes) : data_(data), writes_(writes) {}
+
+  template<typename T> bool save(const T *src) {
+    if (this->data_ == nullptr) return false;
+    this->data_->assign(reinterpret_cast<const uint8_t *>(src), reinterpret_cast<const uint8_t *>(src) + sizeof(T));
+    (*this->writes_)++;
+    return true;
+  }
+  template<typename T> bool load(T *dest) {
+    if (this->data_ == nullptr || this->data_->size() != sizeof(T)) return false;
+    memcpy(dest, this->data_->data(), sizeof(T));
+    return true;
+  }
+
+ protected:
+  std::vector<uint8_t> *data_{nullptr};
+  uint32_t *writes_{nullptr};
+};
+
+class ESPPreferences {
+ public:
+  template<typename T> ESPPreferenceObject make_preference(uint32_t type, bool in_flash = false) {
+    (void) in_flash;
+    // Sized up front like a real backend's slot, so saves don't allocate
+    std::vector<uint8_t> &slot = this->slots[type];
+    slot.reserve(sizeof(T));
+    return ESPPreferenceObject(&slot, &this->writes);
+  }
+  bool sync() { return true; }
+
+  std::map<uint32_t, std::vector<uint8_t>> slots;
+  uint32_t writes{0};
+};
+
+inline ESPPreferences *global_preferences = new ESPPreferences();
+
+namespace output {
+class BinaryOutput {
+ public:
+  bool state{false};
+  void turn_on() { this->state = true; }
+  void turn_off() { this->state = false; }
+};
+
+class FloatOutput {
+ public:
+  float level{0};
+  void set_level(float level) { this->level = level; }
+};
+}  // namespace output
+
+namespace switch_ {
+// A template switch: turn_on()/turn_off() run its action on a change, then
+// publish the optimistic state
+class Switch {
+ public:
+  bool state{false};
+  std::function<void(bool)> write_action;
+  void turn_on() { this->write_state(true); }
+  void turn_off() { this->write_state(false); }
+  void write_state(bool state) {
+    if (state != this->state && this->write_action) this->write_action(state);
+    this->publish_state(state);
+  }
+  void publish_state(bool state) { this->state = state; }
+};
+}  // namespace switch_
+
+namespace number {
+class Number;
+
+// A number's call: set_value() then perform() publishes it
+class NumberCall {
+ public:
+  explicit NumberCall(Number *parent) : parent_(parent) {}
+  NumberCall &set_value(float value) {
+    this->value_ = value;
+    return *this;
+  }
+  void perform();
+
+ protected:
+  Number *parent_;
+  float value_{NAN};
+};
+
+class Number {
+ public:
+  explicit Number(float state = NAN) : state(state) {}
+  float state;
+  void publish_state(float state) { this->state = state; }
+  NumberCall make_call() { return NumberCall(this); }
+};
+
+inline void NumberCall::perform() {
+  if (!std::isnan(this->value_)) this->parent_->publish_state(this->value_);
+}
+}  // namespace number
+
+namespace select {
+class Select {
+ public:
+  explicit Select(const char *state = "") : state(state) {}
+  std::string state;
+};
+}  // namespace select
+
+namespace sensor {
+class Sensor {
+ public:
+  float state{NAN};
+  uint32_t update_interval{1000};
+  uint32_t next_run_ms{0};
+  uint32_t publish_count{0};
+  void publish_state(float state) {
+    this->state = state;
+    this->publish_count++;
+  }
+  // PollingComponent; start_poller() restarts the period from now
+  void set_update_interval(uint32_t update_interval) { this->update_interval = update_interval; }
+  void start_poller() { this->next_run_ms = millis() + this->update_interval; }
+};
+}  // namespace sensor
+
+namespace text_sensor {
+class TextSensor {
+ public:
+  std::string state;
+  uint32_t publish_count{0};
+  void publish_state(const std::string &state) {
+    this->state = state;
+    this->publish_count++;
+  }
+};
+}  // namespace text_sensor
+
+namespace template_ {
+// Template sensors: update() publishes what the lambda returns
+class TemplateSensor : public sensor::Sensor {
+ public:
+  explicit TemplateSensor(float (*lambda)()) : lambda_(lambda) {}
+  void update() { this->publish_state(this->lambda_()); }
+
+ protected:
+  float (*lambda_)();
+};
+
+class TemplateTextSensor : public text_sensor::TextSensor {
+ public:
+  explicit TemplateTextSensor(const char *(*lambda)()) : lambda_(lambda) {}
+  void update() { this->publish_state(this->lambda_()); }
+
+ protected:
+  const char *(*lambda_)();
+};
+}  // namespace template_
+
+namespace interval {
+// An interval: a PollingComponent running its actions every
+// update_interval; start_poller() restarts the period from now
+class IntervalTrigger {
+ public:
+  uint32_t update_interval{1000};
+  uint32_t next_run_ms{0};
+  void set_update_interval(uint32_t update_interval) { this->update_interval = update_interval; }
+  void start_poller() { this->next_run_ms = millis() + this->update_interval; }
+};
+}  // namespace interval
+
+// The main loop: only its pacing between passes
+class Application {
+ public:
+  uint32_t loop_interval{16};
+  void set_loop_interval(uint32_t loop_interval) { this->loop_interval = loop_interval; }
+};
+inline Application App;
+
+namespace globals {
+template<typename T> class GlobalsComponent {
+ public:
+  explicit GlobalsComponent(T initial_value) : value_(initial_value) {}
+  T &value() { return this->value_; }
+
+ protected:
+  T value_;
+};
+}  // namespace globals
+
+}  // namespace esphome
+
+using namespace esphome;
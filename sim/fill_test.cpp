@@ -0,0 +1,46 @@
+// Fill stop through the real helpers
+//
+// Boots the strawberry shelf's helpers, starts a cycle and feeds its fill a
+// level rising at 1 mm/s, sampled as fast as the ToF runs while the pump
+// moves water. The predictor must stop the fill short of target. The stop
+// latency is published from the age of the sample that asked for the stop
+// to the end of the pump's soft-stop ramp, so it is never 0 with a ramp
+// configured, and the early-cutoff lead learns it.
+
+#include "sim_shelf.h"
+#include "flood_helpers.h"
+
+#include <cstdio>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+  printf("%-58s %s\n", what, ok ? "ok" : "FAIL");
+  if (!ok) failures++;
+}
+
+static const float RISE_MM_S = 1.0f;
+
+int main() {
+  bin_1_enable->publish_state(true);
+  sim_clock::set(1000000);
+  float lead_before = fill_control[0].compensation.lead_ms(DEPTH_FAST_INTERVAL_MS);
+  execute_flood_cycle(1);
+  check(get_pump_phase(1) == PumpPhase::FILLING, "cycle starts filling");
+
+  float target = get_target_depth(1);
+  float depth = 0;
+  for (int i = 0; i < 2000 && get_pump_phase(1) == PumpPhase::FILLING; i++) {
+    sim_clock::set(sim_clock::now_ms + DEPTH_FAST_INTERVAL_MS);
+    depth += RISE_MM_S * DEPTH_FAST_INTERVAL_MS / 1000;
+    on_distance_sample(1, bin_1_empty_distance->state - depth);
+  }
+  check(get_pump_phase(1) == PumpPhase::SOAKING && depth < target, "fill stopped short of target");
+
+  float latency = bin_1_stop_latency->state;
+  uint32_t expected = DEPTH_SAMPLE_AGE_MS + get_pump_stop_ms(1);
+  printf("stop latency %.0f ms, soft stop %u ms\n", latency, (unsigned) get_pump_stop_ms(1));
+  check(get_pump_stop_ms(1) > 0 && latency == expected, "latency runs to the end of the soft-stop ramp");
+  check(fill_control[0].compensation.lead_ms(DEPTH_FAST_INTERVAL_MS) > lead_before, "lead learns the latency");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+// Spike traces through the distance filter
+//
+// Each trace is one distance sample per line with the true surface distance
+// beside it. Every filtered sample must be within tolerance of the true
+// distance at that sample or the one before (at most one sample of latency),
+// and every spike must be rejected.
+
+#include "depth_filter.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+static const size_t WINDOW = 7;        // DEPTH_FILTER_WINDOW in flood_helpers.h
+static const float TOLERANCE_MM = 3.0f;  // sensor noise plus median lag on a ramp
+static const float SPIKE_MM = 10.0f;     // raw reading this far off truth is a spike
+
+static bool run_trace(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == nullptr) {
+    fprintf(stderr, "%s: cannot open\n", path);
+    return false;
+  }
+
+  HampelFilter<WINDOW> filter;
+  char line[128];
+  int samples = 0, spikes = 0, failures = 0;
+  float prev_truth = NAN;
+  float worst = 0;
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    unsigned long ms;
+    float distance, truth;
+    if (line[0] == '#' || sscanf(line, "%lu %f %f", &ms, &distance, &truth) != 3) continue;
+    samples++;
+    if (std::fabs(distance - truth) > SPIKE_MM) spikes++;
+
+    float out = filter.apply(distance);
+    float error = std::fabs(out - truth);
+    if (!std::isnan(prev_truth) && std::fabs(out - prev_truth) < error) error = std::fabs(out - prev_truth);
+    if (error > worst) worst = error;
+    if (error > TOLERANCE_MM) {
+      failures++;
+      fprintf(stderr, "%s: %lu ms: raw %.1f, filtered %.1f, true %.1f\n", path, ms, distance, out, truth);
+    }
+    prev_truth = truth;
+  }
+  fclose(file);
+
+  bool ok = failures == 0 && (int) filter.rejected() >= spikes;
+  printf("%-28s %5d samples %3d spikes %3u rejected  worst %.1f mm  %s\n", path, samples, spikes,
+         (unsigned) filter.rejected(), worst, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: filter_test TRACE...\n");
+    return 2;
+  }
+  bool ok = true;
+  for (int i = 1; i < argc; i++) ok = run_trace(argv[i]) && ok;
+  return ok ? 0 : 1;
+}
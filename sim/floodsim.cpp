@@ -0,0 +1,572 @@
+// Virtual-clock simulator for the shelf scheduler
+//
+// Compiles the real esphome/ helpers and a config's bin table against the
+// stand-in esphome.h and runs the scheduler and every bin's flood cycle
+// second by second over months of virtual time, with the pump switches'
+// actions as the YAML has them. Reports, per bin, how many cycles ran, how
+// many watering windows were missed, any double-fires, phases off their set
+// length and how long due bins waited in the queue, and for the shelf the
+// peak pump current against the supply budget and each watering window's
+// makespan, plus the schedule journal's flash writes and a replay check.
+//
+// With --low-power the timer wheel is ticked only when the flood_tick
+// interval comes due, as stretched by low-power idle, and a window missed
+// for it fails the run. So does the pumps drawing more than the budget,
+// summed from the levels on their outputs. The strawberry build also models
+// its tray under the distance sensor, so its fills and drains end on depth;
+// one that runs to its timeout fails the run. Every heap allocation after
+// boot is counted, and any at all fails the run, so the control path stays
+// on fixed buffers and static storage.
+
+#include "sim_shelf.h"
+#include "heap_counter.h"
+#include "flood_helpers.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+enum class SimScheduler {
+  BUDGETED,  // floodshelf.yaml: start_shelf_scheduler()
+  PER_BIN,   // floodshelf_strawberry.yaml: start_bin_schedules()
+};
+
+struct SimOptions {
+  int days = 365;
+#ifdef SIM_PER_BIN_SCHEDULES
+  SimScheduler scheduler = SimScheduler::PER_BIN;
+#else
+  SimScheduler scheduler = SimScheduler::BUDGETED;
+#endif
+  int watering_hour = 9;
+  float budget_amps = 1.0;  // one pump at a time with the default speeds
+  float rated_amps = 1.0;
+  float interval_days = 1;
+  const char *daily_times = nullptr;
+  int fill_minutes = 5;
+  int soak_minutes = 30;
+  int drain_minutes = 10;
+  int stagger_minutes = 0;  // bin n's fill and soak run this much longer per bin before it
+  float fill_speed = 65;
+  float drain_speed = 75;
+  bool low_power = false;
+  time_t start = 1767225600;  // 2026-01-01 00:00 UTC
+};
+
+// A bin's phase as last seen, and when it was entered
+struct SimPhase {
+  PumpPhase phase = PumpPhase::IDLE;
+  time_t since = 0;
+};
+
+struct SimBinStats {
+  int runs = 0;
+  int due = 0;
+  int missed = 0;
+  int double_fires = 0;
+  int mistimed = 0;
+  int depth_ends = 0;  // fills and drains that ended on depth
+  int timeouts = 0;    // and that ran to their timeout instead
+  time_t due_since = 0;
+  time_t last_start = 0;
+  long delay_total = 0;
+  long delay_max = 0;
+  int delay_count = 0;
+};
+
+static SimOptions options;
+static SimPhase phases[SIM_BIN_COUNT];
+static SimBinStats stats[SIM_BIN_COUNT];
+static float peak_amps = 0;
+static unsigned long timer_ticks = 0;
+
+// Watering windows of the budgeted scheduler, from the hour opening to the
+// last of its cycles going idle
+struct SimMakespan {
+  time_t window_start = 0;
+  time_t last_idle = 0;
+  int windows = 0;
+  long total = 0;
+  long max = 0;
+};
+static SimMakespan makespan;
+
+static void sim_close_window() {
+  if (makespan.window_start == 0 || makespan.last_idle < makespan.window_start) return;
+  long span = makespan.last_idle - makespan.window_start;
+  makespan.windows++;
+  makespan.total += span;
+  makespan.max = span > makespan.max ? span : makespan.max;
+}
+
+static time_t sim_now() { return sim_clock::seconds(); }
+
+// Pump switch actions, as the YAML's template switches have them: the pump
+// switch starts and stops the pump, and the reverse switch restarts a running
+// pump in the new direction (at once here, where the YAML waits out the
+// soft stop)
+static unsigned long pump_switches = 0;
+static unsigned long pump_output_mismatches = 0;
+
+static void sim_pump_switch(int bin_num, bool on) {
+  on ? pump_start(bin_num) : pump_stop(bin_num);
+  pump_switches++;
+}
+
+static void sim_reverse_switch(int bin_num, bool on) {
+  const SimBinIds &ids = sim_bin_ids[bin_num - 1];
+  if (!ids.pump->state) return;
+  ids.reverse->publish_state(on);
+  pump_stop(bin_num);
+  pump_start(bin_num);
+}
+
+// A bin's pump as the hardware sees it
+struct SimPumpOutput {
+  float level;
+  bool forward;
+  bool reverse;
+};
+
+static SimPumpOutput sim_read_pump_output(int bin_num) {
+#if SIM_BIN_COUNT == 8
+  const uint8_t *pwm = sim_i2c.registers[SIM_PWM_ADDRESS] + 0x06 + 4 * (bin_num - 1);
+  uint16_t on = pwm[0] | pwm[1] << 8;
+  uint16_t off = pwm[2] | pwm[3] << 8;
+  const uint8_t *olat = sim_i2c.registers[SIM_EXPANDER_ADDRESS] + 0x14;
+  uint16_t pins = olat[0] | olat[1] << 8;
+  int pin = 2 * (bin_num - 1);
+  return {(off & 0x1000) ? 0.0f : (on & 0x1000) ? 1.0f : off / 4096.0f, (bool) ((pins >> pin) & 1),
+          (bool) ((pins >> (pin + 1)) & 1)};
+#else
+  const SimBinIds &ids = sim_bin_ids[bin_num - 1];
+  return {ids.speed_output->level, ids.forward_output->state, ids.reverse_output->state};
+#endif
+}
+
+// Every pump's outputs against its phase: stopped with both pins low, or
+// running in the phase's direction at that direction's speed
+static void sim_check_pump_outputs() {
+  for (int bin_num = 1; bin_num <= SIM_BIN_COUNT; bin_num++) {
+    const SimBinIds &ids = sim_bin_ids[bin_num - 1];
+    PumpPhase phase = get_pump_phase(bin_num);
+    SimPumpOutput out = sim_read_pump_output(bin_num);
+    bool ok;
+    if (phase == PumpPhase::FILLING || phase == PumpPhase::DRAINING) {
+      bool reverse = phase == PumpPhase::FILLING;
+      float level = (reverse ? ids.drain_speed->state : ids.fill_speed->state) / 100;
+      ok = out.reverse == reverse && out.forward == !reverse && fabsf(out.level - level) < 1.0f / 4096;
+    } else {
+      ok = out.level == 0 && !out.forward && !out.reverse;
+    }
+    if (!ok) {
+      pump_output_mismatches++;
+      ESP_LOGW("sim", "Bin %d: %s but pump outputs level %.3f forward %d reverse %d", bin_num,
+               pump_phase_text(phase), out.level, out.forward, out.reverse);
+    }
+  }
+}
+
+// Length the bin table gives a phase, in seconds: the timeout of a step
+// that ends on depth
+static time_t sim_phase_seconds(int bin_num, PumpPhase phase) {
+  switch (phase) {
+    case PumpPhase::FILLING:
+      return (time_t)(bins.get(bin_num, &BinRefs::fill_duration, 0.0f) * 60);
+    case PumpPhase::SOAKING:
+      return (time_t)(bins.get(bin_num, &BinRefs::soak_duration, 0.0f) * 60);
+    case PumpPhase::DRAINING:
+      return (time_t)(bins.get(bin_num, &BinRefs::drain_duration, 0.0f) * 60);
+    default:
+      return 0;
+  }
+}
+
+static bool sim_phase_ends_on_depth(int bin_num, PumpPhase phase) {
+  return (phase == PumpPhase::FILLING && bins[bin_num].fill_end == CycleEnd::DEPTH) ||
+         (phase == PumpPhase::DRAINING && bins[bin_num].drain_end == CycleEnd::DEPTH);
+}
+
+// A cycle started: account for how long the bin was due
+static void sim_cycle_started(int bin_num) {
+  SimBinStats &bin = stats[bin_num - 1];
+  if (options.scheduler == SimScheduler::BUDGETED && bin.due_since == 0) {
+    bin.double_fires++;
+    ESP_LOGW("sim", "Bin %d: started again after %ld min", bin_num, (long)(sim_now() - bin.last_start) / 60);
+  }
+  if (bin.due_since != 0) {
+    long delay = sim_now() - bin.due_since;
+    bin.delay_total += delay;
+    bin.delay_max = delay > bin.delay_max ? delay : bin.delay_max;
+    bin.delay_count++;
+    bin.due_since = 0;
+  }
+  bin.runs++;
+  bin.last_start = sim_now();
+}
+
+// Follow every bin's cycle through its phases: count starts, check each
+// timed phase lasted what its setting says, and each step that ends on depth
+// ended before its timeout
+static void sim_watch_cycles() {
+  for (int bin_num = 1; bin_num <= SIM_BIN_COUNT; bin_num++) {
+    SimPhase &seen = phases[bin_num - 1];
+    PumpPhase phase = get_pump_phase(bin_num);
+    if (phase == seen.phase) continue;
+    time_t expected = sim_phase_seconds(bin_num, seen.phase);
+    time_t lasted = sim_now() - seen.since;
+    if (expected > 0 && sim_phase_ends_on_depth(bin_num, seen.phase)) {
+      if (lasted < expected) {
+        stats[bin_num - 1].depth_ends++;
+      } else {
+        stats[bin_num - 1].timeouts++;
+        ESP_LOGW("sim", "Bin %d: %s ran to its %lds timeout", bin_num, pump_phase_text(seen.phase), (long) expected);
+      }
+    } else if (expected > 0 && (lasted < expected || lasted > expected + 1)) {
+      stats[bin_num - 1].mistimed++;
+      ESP_LOGW("sim", "Bin %d: %s lasted %lds, set to %lds", bin_num, pump_phase_text(seen.phase), (long) lasted,
+               (long) expected);
+    }
+    if (phase == PumpPhase::FILLING) sim_cycle_started(bin_num);
+    if (phase == PumpPhase::IDLE) makespan.last_idle = sim_now();
+    seen.phase = phase;
+    seen.since = sim_now();
+  }
+}
+
+#ifdef SIM_PER_BIN_SCHEDULES
+// The strawberry tray under bin 1's distance sensor: the level rises while
+// the pump runs in reverse and falls while it runs forward, at a rate in
+// proportion to the level on its speed output, and can't drain below empty.
+// Each reading goes through the YAML's filter and on_value lambdas at the
+// rate the sensor is polled, so fills and drains end on depth.
+static const float SIM_TRAY_FILL_MM_S = 1.0f;   // at full speed
+static const float SIM_TRAY_DRAIN_MM_S = 1.0f;  // at full speed
+
+struct SimTray {
+  float empty_distance = 0;  // the sensor's real reading with the tray empty
+  float level = 0;
+  uint32_t sampled_ms = 0;
+};
+static SimTray tray;
+
+static void sim_tray_boot() {
+  tray.empty_distance = bin_1_empty_distance->state;
+  tray.sampled_ms = millis();
+  bin_1_distance->start_poller();
+}
+
+// Poll the distance sensor through the next ms milliseconds, leaving the
+// clock at the last reading
+static void sim_poll_tray(uint32_t ms) {
+  uint32_t until = millis() + ms;
+  int64_t until_ms = sim_clock::now_ms + ms;
+  while ((int32_t)(until - bin_1_distance->next_run_ms) >= 0) {
+    sim_clock::set(until_ms - (int32_t)(until - bin_1_distance->next_run_ms));
+    bin_1_distance->next_run_ms = millis() + bin_1_distance->update_interval;
+    SimPumpOutput out = sim_read_pump_output(1);
+    float rate = out.reverse ? SIM_TRAY_FILL_MM_S : out.forward ? -SIM_TRAY_DRAIN_MM_S : 0;
+    tray.level += rate * out.level * (millis() - tray.sampled_ms) / 1000;
+    tray.level = tray.level < 0 ? 0 : tray.level;
+    tray.sampled_ms = millis();
+    float distance = filter_distance_sample(1, tray.empty_distance - tray.level);
+    bin_1_distance->publish_state(distance);
+    on_distance_sample(1, distance);
+    sim_watch_cycles();
+  }
+}
+#endif
+
+// Current the running pumps draw now, from the levels on their outputs
+static void sim_track_current() {
+  float amps = 0;
+  for (int bin_num = 1; bin_num <= SIM_BIN_COUNT; bin_num++) {
+    amps += options.rated_amps * sim_read_pump_output(bin_num).level;
+  }
+  peak_amps = amps > peak_amps ? amps : peak_amps;
+}
+
+// Independent check of whether a bin should be running now, so the scheduler
+// under test is measured against the intended schedule, not against itself
+static void sim_track_due(const ESPTime &now) {
+  static int last_slot_day[SIM_BIN_COUNT];
+
+  if (options.scheduler == SimScheduler::BUDGETED && now.hour == options.watering_hour && now.minute == 0) {
+    sim_close_window();
+    makespan.window_start = now.timestamp;
+  }
+
+  for (int bin_num = 1; bin_num <= SIM_BIN_COUNT; bin_num++) {
+    SimBinStats &bin = stats[bin_num - 1];
+
+    if (options.scheduler == SimScheduler::BUDGETED) {
+      if (now.hour != options.watering_hour || now.minute != 0) continue;
+      // Next window opened with the bin still waiting: it slipped a day
+      if (bin.due_since != 0) {
+        bin.missed++;
+        bin.due_since = 0;
+      }
+      // Due every interval days, counted in windows, not hours
+      int interval = options.interval_days > 1 ? (int) options.interval_days : 1;
+      if (bin.last_start == 0 || bin.last_start < now.timestamp - (time_t)(interval - 1) * 86400) {
+        bin.due_since = now.timestamp;
+        bin.due++;
+      }
+      continue;
+    }
+
+    // Per-bin schedules: every slot should start a cycle in the same minute
+    bool slot = false;
+    if (options.daily_times != nullptr) {
+      slot = schedule_fires_at(get_daily_schedule(bin_num), now.hour, now.minute);
+    } else if (now.hour == options.watering_hour && now.minute == 0) {
+      int days = (int)(now.timestamp / 86400);
+      slot = last_slot_day[bin_num - 1] == 0 || days - last_slot_day[bin_num - 1] >= (int)options.interval_days;
+      if (slot) last_slot_day[bin_num - 1] = days;
+    }
+    if (bin.due_since != 0) {
+      bin.missed++;
+      bin.due_since = 0;
+    }
+    if (slot) {
+      bin.due++;
+      bin.due_since = now.timestamp;
+    }
+  }
+}
+
+// Replay the journal as a reboot would, into zeroed globals, and compare
+static bool sim_check_journal_replay() {
+  ScheduleRecord before = snapshot_schedule();
+  for (int bin_num = 1; bin_num <= SIM_BIN_COUNT; bin_num++) {
+    bins.set(bin_num, &BinRefs::last_cycle, 0);
+    bins.set(bin_num, &BinRefs::next_cycle, 0);
+    bins.set(bin_num, &BinRefs::last_run_day, 0);
+  }
+  restore_schedule_journal();
+  ScheduleRecord after = snapshot_schedule();
+  return memcmp(&before, &after, sizeof(before)) == 0;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: floodsim1|floodsim4|floodsim8 [options]\n"
+          "  --days N          days to simulate (365)\n"
+          "  --budget A        supply current budget, floodshelf.yaml builds only (1.0)\n"
+          "  --hour H          watering hour (9)\n"
+          "  --interval D      cycle interval days (1)\n"
+          "  --times LIST      daily times for every bin, strawberry build only\n"
+          "  --fill M          fill minutes (5)\n"
+          "  --soak M          soak minutes (30)\n"
+          "  --drain M         drain minutes, where the config sets it (10)\n"
+          "  --stagger M       each bin's fill and soak M minutes longer than the bin before's (0)\n"
+          "  --speeds F,D      fill and drain speed percent (65,75)\n"
+          "  --low-power       turn on low-power idle\n"
+          "  -v                log scheduler activity\n");
+  exit(2);
+}
+
+static void parse_options(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (strcmp(arg, "-v") == 0) {
+      sim_log_level = 3;
+      continue;
+    }
+    if (strcmp(arg, "--low-power") == 0) {
+      options.low_power = true;
+      continue;
+    }
+    if (value == nullptr) usage();
+    i++;
+    if (strcmp(arg, "--days") == 0) {
+      options.days = atoi(value);
+    } else if (strcmp(arg, "--budget") == 0) {
+      options.budget_amps = atof(value);
+    } else if (strcmp(arg, "--hour") == 0) {
+      options.watering_hour = atoi(value);
+    } else if (strcmp(arg, "--interval") == 0) {
+      options.interval_days = atof(value);
+    } else if (strcmp(arg, "--times") == 0) {
+      options.daily_times = value;
+    } else if (strcmp(arg, "--fill") == 0) {
+      options.fill_minutes = atoi(value);
+    } else if (strcmp(arg, "--soak") == 0) {
+      options.soak_minutes = atoi(value);
+    } else if (strcmp(arg, "--drain") == 0) {
+      options.drain_minutes = atoi(value);
+    } else if (strcmp(arg, "--stagger") == 0) {
+      options.stagger_minutes = atoi(value);
+    } else if (strcmp(arg, "--speeds") == 0) {
+      if (sscanf(value, "%f,%f", &options.fill_speed, &options.drain_speed) != 2) usage();
+    } else {
+      usage();
+    }
+  }
+}
+
+static void configure_shelf() {
+#if SIM_BIN_COUNT == 8
+  if (!pump_pwm.setup(1000) || !pump_direction.setup()) exit(2);
+#endif
+#ifndef SIM_PER_BIN_SCHEDULES
+  watering_hour->publish_state(options.watering_hour);
+  supply_current_budget->publish_state(options.budget_amps);
+  pump_rated_current->publish_state(options.rated_amps);
+#endif
+  low_power_idle->publish_state(options.low_power);
+  for (int bin_num = 1; bin_num <= SIM_BIN_COUNT; bin_num++) {
+    const SimBinIds &ids = sim_bin_ids[bin_num - 1];
+    ids.enable->publish_state(true);
+    ids.cycle_interval->publish_state(options.interval_days);
+    int stagger = options.stagger_minutes * (bin_num - 1);
+    ids.fill_duration->publish_state(options.fill_minutes + stagger);
+    ids.soak_duration->publish_state(options.soak_minutes + stagger);
+    if (ids.drain_duration != nullptr) ids.drain_duration->publish_state(options.drain_minutes);
+    ids.fill_speed->publish_state(options.fill_speed);
+    ids.drain_speed->publish_state(options.drain_speed);
+    if (ids.interval_time != nullptr) ids.interval_time->value() = options.watering_hour;
+    ids.pump->write_action = [bin_num](bool on) { sim_pump_switch(bin_num, on); };
+    ids.reverse->write_action = [bin_num](bool on) { sim_reverse_switch(bin_num, on); };
+    if (options.daily_times != nullptr) {
+      if (ids.daily_times == nullptr) usage();
+      ids.schedule_mode->value() = 1;
+      ids.daily_times->publish_state(options.daily_times);
+      if (!update_daily_times(bin_num, ids.daily_times->state)) exit(2);
+    }
+  }
+}
+
+// Returns false if a phase ran off its set length, a fill or drain that ends
+// on depth ran to its timeout, the pumps drew more than the budget, or
+// low-power idle missed a window
+static bool report() {
+  printf("floodsim: %d bins, %d days, %s scheduler, ", SIM_BIN_COUNT, options.days,
+         options.scheduler == SimScheduler::BUDGETED ? "budgeted" : "per-bin");
+  if (options.daily_times != nullptr) {
+    printf("daily times %s", options.daily_times);
+  } else {
+    printf("every %g d at %02d:00", options.interval_days, options.watering_hour);
+  }
+  printf(", phases %g/%g/%g min", bins.get(1, &BinRefs::fill_duration, 0.0f), bins.get(1, &BinRefs::soak_duration, 0.0f),
+         bins.get(1, &BinRefs::drain_duration, 0.0f));
+  if (options.stagger_minutes > 0) printf(" + %d min per bin", options.stagger_minutes);
+  printf(", speeds %g/%g%%", options.fill_speed, options.drain_speed);
+  if (options.scheduler == SimScheduler::BUDGETED) printf(", %.2f A budget", options.budget_amps);
+  if (options.low_power) printf(", low-power idle");
+  printf("\n\n");
+
+  printf("bin   runs    due  missed  double  mistimed  delay avg  delay max  status pubs\n");
+  SimBinStats total;
+  uint32_t total_pubs = 0;
+  for (int bin_num = 1; bin_num <= SIM_BIN_COUNT; bin_num++) {
+    SimBinStats &bin = stats[bin_num - 1];
+    bin.double_fires += flood_cycles[bin_num - 1].ignored_starts();
+    uint32_t pubs = sim_bin_ids[bin_num - 1].status->publish_count;
+    printf("%3d %6d %6d %7d %7d %9d %8.1fm %9ldm %12u\n", bin_num, bin.runs, bin.due, bin.missed, bin.double_fires,
+           bin.mistimed, bin.delay_count ? bin.delay_total / 60.0 / bin.delay_count : 0.0, bin.delay_max / 60, pubs);
+    total.runs += bin.runs;
+    total.due += bin.due;
+    total.missed += bin.missed;
+    total.double_fires += bin.double_fires;
+    total.mistimed += bin.mistimed;
+    total.depth_ends += bin.depth_ends;
+    total.timeouts += bin.timeouts;
+    total.delay_total += bin.delay_total;
+    total.delay_count += bin.delay_count;
+    total.delay_max = bin.delay_max > total.delay_max ? bin.delay_max : total.delay_max;
+    total_pubs += pubs;
+  }
+  printf("all %6d %6d %7d %7d %9d %8.1fm %9ldm %12u\n", total.runs, total.due, total.missed, total.double_fires,
+         total.mistimed, total.delay_count ? total.delay_total / 60.0 / total.delay_count : 0.0, total.delay_max / 60, total_pubs);
+  uint32_t countdown_pubs = 0;
+  for (int bin_num = 1; bin_num <= SIM_BIN_COUNT; bin_num++) {
+    countdown_pubs += *sim_bin_ids[bin_num - 1].countdown_publishes;
+  }
+  printf("\nper-bin status and countdown publishes %u, shelf state publishes %u\n", total_pubs + countdown_pubs,
+         (unsigned) shelf_state->publish_count);
+  printf("shelf state %s\n", shelf_state->state.c_str());
+#ifdef SIM_PER_BIN_SCHEDULES
+  printf("fills and drains ended on depth %d, ran to timeout %d; last stop latency %.0f ms, fill error %.1f mm\n",
+         total.depth_ends, total.timeouts, bin_1_stop_latency->state, bin_1_fill_error->state);
+#endif
+  if (options.scheduler == SimScheduler::BUDGETED) {
+    sim_close_window();
+    printf("\npeak pump current %.2f A of %.2f A budget%s\n", peak_amps, options.budget_amps,
+           peak_amps > options.budget_amps + 1e-3f ? "  OVER BUDGET" : "");
+    printf("makespan avg %.1fm, max %ldm over %d windows; firmware saw last %dm, %d missed\n",
+           makespan.windows ? makespan.total / 60.0 / makespan.windows : 0.0, makespan.max / 60, makespan.windows,
+           get_last_makespan_minutes(), get_missed_watering_windows());
+  }
+  service_schedule_journal();
+  bool replayed = sim_check_journal_replay();
+  printf("helper timing (us, host) %s\n", format_timing_stats());
+  printf("status publishes, published/avoided %s\n", format_publish_stats());
+  printf("schedule journal %u flash writes (%.1f/day), replay %s\n", (unsigned) global_preferences->writes,
+         (double) global_preferences->writes / options.days, replayed ? "ok" : "MISMATCH");
+  printf("timer ticks %lu (%.0f/day)\n", timer_ticks, (double) timer_ticks / options.days);
+  bool in_budget = options.scheduler != SimScheduler::BUDGETED || peak_amps <= options.budget_amps + 1e-3f;
+  return total.mistimed == 0 && total.timeouts == 0 && in_budget && (!options.low_power || total.missed == 0);
+}
+
+int main(int argc, char **argv) {
+  parse_options(argc, argv);
+  configure_shelf();
+
+  sim_clock::set((int64_t) options.start * 1000);
+  restore_schedule_journal();
+  restore_shelf_clock();
+  resume_flood_cycles();
+  publish_all_pump_status();
+#ifdef SIM_PER_BIN_SCHEDULES
+  sim_tray_boot();
+#endif
+  if (options.scheduler == SimScheduler::BUDGETED) {
+    start_shelf_scheduler();
+  } else {
+    start_bin_schedules();
+  }
+
+  sim_counting_allocations = true;
+#if SIM_BIN_COUNT == 8
+  uint32_t boot_bus_writes = sim_i2c.writes;
+#endif
+  time_t end = options.start + (time_t) options.days * 86400;
+  for (time_t t = options.start; t < end; t += 60) {
+    sim_clock::set((int64_t) t * 1000);
+    ESPTime now = id(homeassistant_time).now();
+    sim_track_due(now);
+    // The YAML ticks the timer wheel from the flood_tick interval, every
+    // second unless low-power idle stretches it, and cycle steps run off it,
+    // so follow the cycles and the pump current each second, and the tray's
+    // readings through the second after each tick
+    for (int second = 0; second < 60; second++) {
+      sim_clock::set((int64_t)(t + second) * 1000);
+      if ((int32_t)(millis() - flood_tick->next_run_ms) >= 0) {
+        flood_tick->next_run_ms = millis() + flood_tick->update_interval;
+        service_timers();
+        timer_ticks++;
+      }
+#ifdef SIM_PER_BIN_SCHEDULES
+      sim_poll_tray(999);
+#endif
+      sim_watch_cycles();
+      sim_track_current();
+    }
+    sim_check_pump_outputs();
+  }
+
+  sim_counting_allocations = false;
+
+  bool timed = report();
+#if SIM_BIN_COUNT == 8
+  printf("pump outputs %lu switch steps, %u bus writes, %lu mismatches\n", pump_switches,
+         (unsigned) (sim_i2c.writes - boot_bus_writes), pump_output_mismatches);
+#else
+  printf("pump outputs %lu switch steps, direct, %lu mismatches\n", pump_switches, pump_output_mismatches);
+#endif
+  printf("heap allocations after boot %lu\n", sim_allocations);
+  if (sim_log_level >= 2) dump_cycle_telemetry();
+  return sim_allocations == 0 && pump_output_mismatches == 0 && timed ? 0 : 1;
+}
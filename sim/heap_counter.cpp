@@ -0,0 +1,19 @@
+#include "heap_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+bool sim_counting_allocations = false;
+unsigned long sim_allocations = 0;
+
+void *operator new(size_t size) {
+  if (sim_counting_allocations) sim_allocations++;
+  void *p = malloc(size ? size : 1);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
@@ -0,0 +1,8 @@
+#pragma once
+
+// Counts global operator new calls while enabled, to show the helpers run
+// without heap allocation after boot. Defined in heap_counter.cpp, its own
+// translation unit, so the replaced operators never get inlined into callers.
+
+extern bool sim_counting_allocations;
+extern unsigned long sim_allocations;
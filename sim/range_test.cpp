@@ -0,0 +1,200 @@
+// Multiplexed VL6180X ranging against a fake bus
+//
+// A TCA9548A and up to eight VL6180X sensors on a fake I2C bus, on the
+// virtual clock: a conversion takes 12 ms and every bus transaction 100 us.
+// Measures the aggregate sample rate of MuxedRangeScheduler against reading
+// the sensors one after the other (select, start, wait, read), and checks
+// that sensors of filling bins keep their rate while the rest idle.
+
+#include "range_scheduler.h"
+
+#include <cstdio>
+#include <cstring>
+
+static const uint8_t MUX_ADDRESS = 0x70;
+static const int64_t CONVERSION_US = 12000;
+static const int64_t TRANSACTION_US = 100;
+static const int64_t LOOP_US = 200;  // everything else a loop() pass does
+
+// Fake bus on a microsecond clock; millis() follows it
+struct FakeBus {
+  int64_t now_us = 0;
+  uint8_t mux_mask = 0;
+  uint32_t transactions = 0;
+  uint32_t errors = 0;
+  struct Sensor {
+    uint8_t fresh = 1;
+    bool converting = false;
+    bool ready = false;
+    int64_t done_us = 0;
+    uint8_t range = 0;
+  } sensors[8];
+
+  void tick(int64_t us) {
+    this->now_us += us;
+    sim_clock::set(this->now_us / 1000);
+  }
+
+  // The one sensor the mux routes to, or null (and an error) if not exactly one
+  Sensor *selected() {
+    if (this->mux_mask == 0 || (this->mux_mask & (this->mux_mask - 1)) != 0) {
+      this->errors++;
+      return nullptr;
+    }
+    return &this->sensors[__builtin_ctz(this->mux_mask)];
+  }
+
+  void update(Sensor &sensor) {
+    if (sensor.converting && this->now_us >= sensor.done_us) {
+      sensor.converting = false;
+      sensor.ready = true;
+    }
+  }
+};
+
+static FakeBus bus;
+
+static bool fake_write(uint8_t address, const uint8_t *data, size_t len) {
+  bus.transactions++;
+  bus.tick(TRANSACTION_US);
+  if (address == MUX_ADDRESS && len == 1) {
+    bus.mux_mask = data[0];
+    return true;
+  }
+  FakeBus::Sensor *sensor = bus.selected();
+  if (address != 0x29 || len != 3 || sensor == nullptr) return false;
+  uint16_t reg = (data[0] << 8) | data[1];
+  if (reg == 0x018 && data[2] == 0x01) {
+    sensor->converting = true;
+    sensor->ready = false;
+    sensor->done_us = bus.now_us + CONVERSION_US;
+    sensor->range = 40 + (uint8_t)(sensor - bus.sensors);
+  } else if (reg == 0x015) {
+    sensor->ready = false;
+  } else if (reg == 0x016) {
+    sensor->fresh = data[2];
+  }
+  return true;
+}
+
+static bool fake_write_read(uint8_t address, const uint8_t *reg_bytes, size_t reg_len, uint8_t *data, size_t len) {
+  bus.transactions++;
+  bus.tick(TRANSACTION_US);
+  FakeBus::Sensor *sensor = bus.selected();
+  if (address != 0x29 || reg_len != 2 || len != 1 || sensor == nullptr) return false;
+  bus.update(*sensor);
+  uint16_t reg = (reg_bytes[0] << 8) | reg_bytes[1];
+  switch (reg) {
+    case 0x04F: data[0] = sensor->ready ? 0x04 : 0x00; break;
+    case 0x062: data[0] = sensor->range; break;
+    case 0x04D: data[0] = 0x00; break;
+    case 0x016: data[0] = sensor->fresh; break;
+    default: data[0] = 0x00; break;
+  }
+  return true;
+}
+
+static uint32_t published[8];
+static uint32_t bad_samples;
+static uint32_t failed_runs;  // runs with a wrong sample or a misrouted transaction
+
+template<int I> void publish_sample(float mm) {
+  published[I]++;
+  if (mm != 40 + I) bad_samples++;
+}
+
+static const RangeSensor SENSORS[8] = {
+    {0, publish_sample<0>}, {1, publish_sample<1>}, {2, publish_sample<2>}, {3, publish_sample<3>},
+    {4, publish_sample<4>}, {5, publish_sample<5>}, {6, publish_sample<6>}, {7, publish_sample<7>},
+};
+
+static void reset_bus() {
+  bus = FakeBus();
+  sim_clock::set(0);
+  memset(published, 0, sizeof(published));
+  bad_samples = 0;
+}
+
+// Aggregate samples/s with the scheduler, every sensor as fast as it can go
+template<size_t N> static float scheduled_rate(uint32_t run_ms) {
+  reset_bus();
+  MuxedRangeScheduler<N> scheduler(fake_write, fake_write_read, MUX_ADDRESS, SENSORS);
+  if (!scheduler.setup()) return 0;
+  for (size_t i = 0; i < N; i++) scheduler.set_interval(i, 0);
+  uint32_t start = scheduler.samples();
+  int64_t start_us = bus.now_us;
+  while (bus.now_us - start_us < (int64_t) run_ms * 1000) {
+    scheduler.service();
+    bus.tick(LOOP_US);
+  }
+  if (bad_samples > 0 || bus.errors > 0) failed_runs++;
+  return (scheduler.samples() - start) * 1000.0f / run_ms;
+}
+
+// Aggregate samples/s reading the sensors in turn, waiting out each conversion
+static float sequential_rate(size_t n, uint32_t run_ms) {
+  reset_bus();
+  uint32_t samples = 0;
+  while (bus.now_us < (int64_t) run_ms * 1000) {
+    for (size_t i = 0; i < n; i++) {
+      uint8_t mask = 1 << i;
+      uint8_t start[3] = {0x00, 0x18, 0x01};
+      uint8_t status_reg[2] = {0x00, 0x4F};
+      uint8_t range_reg[2] = {0x00, 0x62};
+      uint8_t clear[3] = {0x00, 0x15, 0x07};
+      uint8_t value = 0;
+      fake_write(MUX_ADDRESS, &mask, 1);
+      fake_write(0x29, start, sizeof(start));
+      do {
+        bus.tick(1000);  // delay(1) between polls
+        fake_write_read(0x29, status_reg, sizeof(status_reg), &value, 1);
+      } while ((value & 0x07) != 0x04);
+      fake_write_read(0x29, range_reg, sizeof(range_reg), &value, 1);
+      fake_write(0x29, clear, sizeof(clear));
+      samples++;
+    }
+  }
+  return samples * 1000.0f / run_ms;
+}
+
+// Two bins filling at 50 ms, six idle at 5 s, for a minute
+static bool check_priority() {
+  reset_bus();
+  MuxedRangeScheduler<8> scheduler(fake_write, fake_write_read, MUX_ADDRESS, SENSORS);
+  if (!scheduler.setup()) return false;
+  for (size_t i = 0; i < 8; i++) scheduler.set_interval(i, i < 2 ? 50 : 5000);
+  int64_t start_us = bus.now_us;
+  memset(published, 0, sizeof(published));
+  const uint32_t run_ms = 60000;
+  while (bus.now_us - start_us < (int64_t) run_ms * 1000) {
+    scheduler.service();
+    bus.tick(LOOP_US);
+  }
+  float active_hz = (published[0] + published[1]) * 1000.0f / (2 * run_ms);
+  float idle_hz = 0;
+  for (size_t i = 2; i < 8; i++) idle_hz += published[i] * 1000.0f / (6 * run_ms);
+  bool ok = active_hz >= 19.0f && active_hz <= 20.5f && idle_hz >= 0.19f && idle_hz <= 0.21f && bad_samples == 0 &&
+            bus.errors == 0;
+  printf("priority: 2 filling at %.1f Hz each, 6 idle at %.2f Hz each  %s\n", active_hz, idle_hz, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+int main() {
+  const uint32_t run_ms = 10000;
+  float one = scheduled_rate<1>(run_ms);
+  float four = scheduled_rate<4>(run_ms);
+  float eight = scheduled_rate<8>(run_ms);
+  bool ok = failed_runs == 0;
+  float rates[3] = {one, four, eight};
+  size_t counts[3] = {1, 4, 8};
+  for (int k = 0; k < 3; k++) {
+    float sequential = sequential_rate(counts[k], run_ms);
+    printf("%zu sensor%s: %6.1f samples/s overlapped, %6.1f sequential\n", counts[k], counts[k] > 1 ? "s" : " ",
+           rates[k], sequential);
+  }
+  // Near-linear until the bus fills up
+  bool scaling = four >= 3.5f * one && eight >= 6.0f * one;
+  printf("scaling: x%.1f at 4 sensors, x%.1f at 8  %s\n", four / one, eight / one, scaling ? "ok" : "FAIL");
+  ok = check_priority() && scaling && ok;
+  return ok ? 0 : 1;
+}
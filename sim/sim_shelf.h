@@ -0,0 +1,222 @@
+#pragma once
+
+// Simulated shelf: stand-ins for the ids a YAML config declares, then that
+// config's own bin table, so the sim runs the table that ships. SIM_BIN_COUNT
+// picks the config: 1 is floodshelf_strawberry.yaml, 4 is floodshelf.yaml.
+// 8 is the multiplexed build, which has no config yet; its table is here,
+// with floodshelf.yaml's entities on I2C driver boards.
+
+#include "esphome.h"
+
+#ifndef SIM_BIN_COUNT
+#define SIM_BIN_COUNT 4
+#endif
+
+// From flood_helpers.h, which includes the bin table first; the countdown
+// templates call them
+float calculate_countdown_hours(int pump_num);
+const char *calculate_countdown_text(int pump_num);
+
+time::RealTimeClock *homeassistant_time = new time::RealTimeClock();
+time::RealTimeClock *sntp_time = new time::RealTimeClock();
+text_sensor::TextSensor *shelf_state = new text_sensor::TextSensor();
+switch_::Switch *low_power_idle = new switch_::Switch();
+interval::IntervalTrigger *flood_tick = new interval::IntervalTrigger();
+
+// Per-bin ids the simulator drives directly, indexed by bin number - 1; an
+// entity the config doesn't have is nullptr
+struct SimBinIds {
+  switch_::Switch *enable;
+  number::Number *cycle_interval;
+  number::Number *fill_duration;
+  number::Number *soak_duration;
+  number::Number *drain_duration;
+  number::Number *fill_speed;
+  number::Number *drain_speed;
+  text_sensor::TextSensor *daily_times;
+  globals::GlobalsComponent<int> *schedule_mode;
+  globals::GlobalsComponent<int> *interval_time;
+  text_sensor::TextSensor *status;
+  const uint32_t *countdown_publishes;
+  switch_::Switch *pump;
+  switch_::Switch *reverse;
+  output::FloatOutput *speed_output;
+  output::BinaryOutput *forward_output;
+  output::BinaryOutput *reverse_output;
+};
+
+#if SIM_BIN_COUNT == 1
+// floodshelf_strawberry.yaml: one depth-controlled bin on per-bin schedules,
+// its numbers and globals at the YAML's initial values
+#define SIM_PER_BIN_SCHEDULES
+
+switch_::Switch *bin_1_enable = new switch_::Switch();
+number::Number *bin_1_target_depth = new number::Number(50);
+number::Number *bin_1_empty_distance = new number::Number(200);
+sensor::Sensor *bin_1_distance = new sensor::Sensor();
+number::Number *pump_1_cycle_interval = new number::Number(5);
+number::Number *bin_1_max_fill_time = new number::Number(15);
+number::Number *pump_1_soak_duration = new number::Number(60);
+number::Number *pump_1_fill_speed = new number::Number(65);
+number::Number *pump_1_drain_speed = new number::Number(75);
+text_sensor::TextSensor *ha_bin_1_daily_times = new text_sensor::TextSensor();
+globals::GlobalsComponent<int> *bin_1_schedule_mode = new globals::GlobalsComponent<int>(0);
+globals::GlobalsComponent<int> *bin_1_interval_time = new globals::GlobalsComponent<int>(10);
+globals::GlobalsComponent<int> *bin_1_next_cycle = new globals::GlobalsComponent<int>(0);
+globals::GlobalsComponent<int> *pump_1_last_cycle = new globals::GlobalsComponent<int>(0);
+globals::GlobalsComponent<int> *bin_1_last_run_day = new globals::GlobalsComponent<int>(0);
+globals::GlobalsComponent<float> *bin_1_sensor_zero_offset = new globals::GlobalsComponent<float>(0);
+text_sensor::TextSensor *pump_1_status = new text_sensor::TextSensor();
+sensor::Sensor *bin_1_stop_latency = new sensor::Sensor();
+sensor::Sensor *bin_1_fill_error = new sensor::Sensor();
+sensor::Sensor *bin_1_calibration_confidence = new sensor::Sensor();
+// Same lambda as the YAML's
+template_::TemplateTextSensor *pump_1_countdown_text =
+    new template_::TemplateTextSensor([]() { return calculate_countdown_text(1); });
+switch_::Switch *pump_1 = new switch_::Switch();
+switch_::Switch *pump_1_reverse = new switch_::Switch();
+number::Number *bin_1_drain_plateau_rate = new number::Number(1.5);
+number::Number *bin_1_drain_plateau_window = new number::Number(15);
+switch_::Switch *bin_1_auto_calibrate = new switch_::Switch();
+output::FloatOutput *motor_a_speed = new output::FloatOutput();
+output::BinaryOutput *motor_a_in1 = new output::BinaryOutput();
+output::BinaryOutput *motor_a_in2 = new output::BinaryOutput();
+
+#include "floodshelf_strawberry_bins.h"
+
+static const SimBinIds sim_bin_ids[SIM_BIN_COUNT] = {
+    {bin_1_enable, pump_1_cycle_interval, bin_1_max_fill_time, pump_1_soak_duration, nullptr, pump_1_fill_speed,
+     pump_1_drain_speed, ha_bin_1_daily_times, bin_1_schedule_mode, bin_1_interval_time, pump_1_status,
+     &pump_1_countdown_text->publish_count, pump_1, pump_1_reverse, motor_a_speed, motor_a_in1, motor_a_in2},
+};
+
+#elif SIM_BIN_COUNT == 4 || SIM_BIN_COUNT == 8
+// floodshelf.yaml's entities, at its initial values: one bin on the
+// budgeted shelf scheduler
+#define SIM_SHELF_BIN_IDS(n) \
+  switch_::Switch *bin_##n##_enable = new switch_::Switch(); \
+  number::Number *pump_##n##_cycle_interval = new number::Number(1); \
+  number::Number *pump_##n##_fill_duration = new number::Number(5); \
+  number::Number *pump_##n##_soak_duration = new number::Number(30); \
+  number::Number *pump_##n##_drain_duration = new number::Number(10); \
+  number::Number *pump_##n##_fill_speed = new number::Number(65); \
+  number::Number *pump_##n##_drain_speed = new number::Number(75); \
+  globals::GlobalsComponent<int> *pump_##n##_last_cycle = new globals::GlobalsComponent<int>(0); \
+  text_sensor::TextSensor *pump_##n##_status = new text_sensor::TextSensor(); \
+  template_::TemplateSensor *pump_##n##_countdown = \
+      new template_::TemplateSensor([]() { return calculate_countdown_hours(n); }); \
+  switch_::Switch *pump_##n = new switch_::Switch(); \
+  switch_::Switch *pump_##n##_reverse = new switch_::Switch();
+
+number::Number *watering_hour = new number::Number(9);
+number::Number *supply_current_budget = new number::Number(1.0);
+number::Number *pump_rated_current = new number::Number(1.0);
+
+#define SIM_SHELF_BIN_ID_ENTRY(n, speed_output, forward_output, reverse_output) \
+  {bin_##n##_enable, pump_##n##_cycle_interval, pump_##n##_fill_duration, pump_##n##_soak_duration, \
+   pump_##n##_drain_duration, pump_##n##_fill_speed, pump_##n##_drain_speed, nullptr, nullptr, nullptr, \
+   pump_##n##_status, &pump_##n##_countdown->publish_count, pump_##n, pump_##n##_reverse, speed_output, \
+   forward_output, reverse_output},
+
+#if SIM_BIN_COUNT == 4
+SIM_SHELF_BIN_IDS(1) SIM_SHELF_BIN_IDS(2) SIM_SHELF_BIN_IDS(3) SIM_SHELF_BIN_IDS(4)
+
+// HW-095 pins, as floodshelf.yaml names them
+output::FloatOutput *motor_a_speed = new output::FloatOutput();
+output::BinaryOutput *motor_a_in1 = new output::BinaryOutput();
+output::BinaryOutput *motor_a_in2 = new output::BinaryOutput();
+output::FloatOutput *motor_b_speed = new output::FloatOutput();
+output::BinaryOutput *motor_b_in3 = new output::BinaryOutput();
+output::BinaryOutput *motor_b_in4 = new output::BinaryOutput();
+output::FloatOutput *motor_c_speed = new output::FloatOutput();
+output::BinaryOutput *motor_c_in1 = new output::BinaryOutput();
+output::BinaryOutput *motor_c_in2 = new output::BinaryOutput();
+output::FloatOutput *motor_d_speed = new output::FloatOutput();
+output::BinaryOutput *motor_d_in3 = new output::BinaryOutput();
+output::BinaryOutput *motor_d_in4 = new output::BinaryOutput();
+
+#include "floodshelf_bins.h"
+
+static const SimBinIds sim_bin_ids[SIM_BIN_COUNT] = {
+    SIM_SHELF_BIN_ID_ENTRY(1, motor_a_speed, motor_a_in1, motor_a_in2)
+    SIM_SHELF_BIN_ID_ENTRY(2, motor_b_speed, motor_b_in3, motor_b_in4)
+    SIM_SHELF_BIN_ID_ENTRY(3, motor_c_speed, motor_c_in1, motor_c_in2)
+    SIM_SHELF_BIN_ID_ENTRY(4, motor_d_speed, motor_d_in3, motor_d_in4)
+};
+
+#else
+#include "bin_set.h"
+#include "pump_outputs.h"
+
+#define FLOOD_BIN_COUNT 8
+#define SIM_FOR_EACH_BIN(X) X(1) X(2) X(3) X(4) X(5) X(6) X(7) X(8)
+
+SIM_FOR_EACH_BIN(SIM_SHELF_BIN_IDS)
+
+// I2C bus of the 8-bin shelf's driver boards: a register image per address,
+// written with the auto-increment both chips use, and a transaction count
+struct SimI2CBus {
+  uint8_t registers[128][256] = {};
+  uint32_t writes = 0;
+};
+static SimI2CBus sim_i2c;
+
+static bool sim_i2c_write(uint8_t address, const uint8_t *data, size_t len) {
+  sim_i2c.writes++;
+  if (address >= 128 || len == 0) return false;
+  for (size_t i = 1; i < len; i++) sim_i2c.registers[address][(uint8_t)(data[0] + i - 1)] = data[i];
+  return true;
+}
+
+static const uint8_t SIM_PWM_ADDRESS = 0x40;
+static const uint8_t SIM_EXPANDER_ADDRESS = 0x20;
+
+// Speed on PCA9685 channels 0-7, direction pins in pairs on an MCP23017
+static Pca9685Bank pump_pwm(sim_i2c_write, SIM_PWM_ADDRESS);
+static ExpanderPort<16> pump_direction(sim_i2c_write, SIM_EXPANDER_ADDRESS, ExpanderKind::MCP23017);
+
+// floodshelf_bins.h's entries, with the pumps on the driver boards
+#define SIM_BIN(n) \
+  { \
+    .enable = FLOOD_STATE(bin_##n##_enable), \
+    .cycle_interval = FLOOD_STATE(pump_##n##_cycle_interval), \
+    .fill_duration = FLOOD_STATE(pump_##n##_fill_duration), \
+    .soak_duration = FLOOD_STATE(pump_##n##_soak_duration), \
+    .drain_duration = FLOOD_STATE(pump_##n##_drain_duration), \
+    .fill_speed = FLOOD_STATE(pump_##n##_fill_speed), \
+    .drain_speed = FLOOD_STATE(pump_##n##_drain_speed), \
+    .last_cycle = FLOOD_GLOBAL(pump_##n##_last_cycle), \
+    .publish_status = FLOOD_PUBLISH(pump_##n##_status), \
+    .update_countdown = FLOOD_UPDATE(pump_##n##_countdown), \
+    .pump_on = FLOOD_STATE(pump_##n), \
+    .reverse = FLOOD_STATE(pump_##n##_reverse), \
+    .set_direction = EXPANDER_HBRIDGE(pump_direction, 2 * (n - 1), 2 * (n - 1) + 1), \
+    .set_speed_level = PCA9685_LEVEL(pump_pwm, n - 1), \
+    .set_pump = FLOOD_SWITCH(pump_##n), \
+    .set_reverse = FLOOD_SWITCH(pump_##n##_reverse), \
+  },
+
+static constexpr BinSet<FLOOD_BIN_COUNT> bins = {{SIM_FOR_EACH_BIN(SIM_BIN)}};
+
+static constexpr ShelfRefs shelf = {
+  .watering_hour = FLOOD_STATE(watering_hour),
+  .supply_budget = FLOOD_STATE(supply_current_budget),
+  .pump_rated_current = FLOOD_STATE(pump_rated_current),
+  .flush_outputs =
+      []() {
+        pump_pwm.flush();
+        pump_direction.flush();
+      },
+  .publish_state = FLOOD_PUBLISH_RESERVED(shelf_state, 256),
+  .low_power = FLOOD_STATE(low_power_idle),
+  .set_tick_interval = FLOOD_POLL_INTERVAL(flood_tick),
+};
+
+// No direct outputs: sim_read_pump_output() reads the bus
+#define SIM_NO_OUTPUT(n) SIM_SHELF_BIN_ID_ENTRY(n, nullptr, nullptr, nullptr)
+static const SimBinIds sim_bin_ids[SIM_BIN_COUNT] = {SIM_FOR_EACH_BIN(SIM_NO_OUTPUT)};
+#endif
+
+#else
+#error "SIM_BIN_COUNT must be 1, 4 or 8"
+#endif